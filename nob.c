@@ -21,7 +21,7 @@ typedef struct {
 
 bool build_it(Project p) {
     Nob_Cmd cmd = {0};
-    nob_cmd_append(&cmd, "cc", "-ggdb", "-Wall", "-Wextra", "-o", nob_temp_sprintf(BUILD_FOLDER"%s", p.app_name), nob_temp_sprintf(SRC_FOLDER"%s", p.src_name));
+    nob_cmd_append(&cmd, "cc", "-ggdb", "-Wall", "-Wextra", "-I.", "-pthread", "-o", nob_temp_sprintf(BUILD_FOLDER"%s", p.app_name), nob_temp_sprintf(SRC_FOLDER"%s", p.src_name));
     return nob_cmd_run_sync_and_reset(&cmd);
 }
 
@@ -72,7 +72,8 @@ int main(int argc, char **argv)
     
     Projects projects = {0};
     add_project(&projects, "json_builder", "json_builder.c", "builder");
-    add_project(&projects, "json_parser", "json_parser.c", "parser");
+    add_project(&projects, "json_parser", "json.c", "parser");
+    add_project(&projects, "json_test", "json_test.c", "test");
 
     if (!nob_mkdir_if_not_exists(BUILD_FOLDER)) return 1;
 
@@ -93,7 +94,7 @@ int main(int argc, char **argv)
             if (p) {
                 build_and_run(*p);
             } else {
-                nob_log(NOB_ERROR, "Invalid app name provided to nob! (`parser` or `builder`)");
+                nob_log(NOB_ERROR, "Invalid app name provided to nob! (`parser`, `builder` or `test`)");
                 return 1;
             }
         } else if (strcmp(param, "build") == 0) {
@@ -106,7 +107,7 @@ int main(int argc, char **argv)
             if (p) {
                 build_it(*p);
             } else{
-                nob_log(NOB_ERROR, "Invalid app name provided to nob! (`parser` or `builder`)");
+                nob_log(NOB_ERROR, "Invalid app name provided to nob! (`parser`, `builder` or `test`)");
                 return 1;
             }
         } else if (strcmp(param, "debug") == 0) {
@@ -119,7 +120,7 @@ int main(int argc, char **argv)
             if (p) {
                 debug_it(*p);
             } else {
-                nob_log(NOB_ERROR, "Invalid app name provided to nob! (`parser` or `builder`)");
+                nob_log(NOB_ERROR, "Invalid app name provided to nob! (`parser`, `builder` or `test`)");
                 return 1;
             }
         }
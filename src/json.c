@@ -1,11 +1,27 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
 
 #define NOB_IMPLEMENTATION
 #include "./nob.h"
+#define JSON_SIMD_IMPLEMENTATION
+#include "json_simd.h"
+#define JSON_NUMBER_IMPLEMENTATION
+#include "json_number.h"
+#define JSON_THREAD_IMPLEMENTATION
+#include "json_thread.h"
 
+// default for JSON_WRITE_PRETTY, see Json_Write_Options
 #define SPACES_FOR_INDENT 4
-#define PRETTY_PRINT true
 
 typedef enum {
     TK_NONE,
@@ -19,6 +35,8 @@ typedef enum {
 
     TK_STRING,
     TK_FLOAT,
+    TK_INT,
+    TK_UINT,
     TK_TRUE,
     TK_FALSE,
     TK_NULL,
@@ -28,8 +46,18 @@ typedef enum {
 
 typedef struct {
     Token_Kind kind;
-    char *text;
-    float num;
+    // Points into the input buffer. For strings the surrounding quotes are
+    // not included and escape sequences are left as they are in the input.
+    Nob_String_View text;
+    // The string contains at least one backslash escape, so `text` has to go
+    // through UnescapeString before it can be used as decoded text.
+    bool escaped;
+    union {
+        double num;
+        int64_t integer;
+        // integers above INT64_MAX
+        uint64_t uinteger;
+    };
 } Token;
 
 typedef struct {
@@ -47,6 +75,8 @@ typedef enum {
 
     JK_STRING,
     JK_FLOAT,
+    JK_INT,
+    JK_UINT,
     JK_BOOLEAN,
     JK_NULL,
 
@@ -54,15 +84,29 @@ typedef enum {
 } Json_Kind;
 
 struct Json_Element;
+struct Json_Object_Index;
 
 typedef struct Json_Element {
     Json_Kind kind;
-    const char *key;
     bool open;
+    // NUL-terminated, but keys may hold \u0000 too, so key_len is the length
+    const char *key;
+    size_t key_len;
+    // members of an object, elements of an array, or bytes in a string
+    // (which may hold \u0000, so strlen does not always work on it)
+    size_t count;
+    union {
+        // hash index over the members of a large object, see json_object_get
+        struct Json_Object_Index *index;
+        // the elements of an array in order, see json_array_at
+        struct Json_Element **items;
+    };
 
     union {
         char *text;
-        float num;
+        double num;
+        int64_t integer;
+        uint64_t uinteger;
         bool boolean;
         struct Json_Element *object;
         struct Json_Element *array;
@@ -83,6 +127,8 @@ const char *GetTokenKind(Token_Kind kind) {
         case TK_COMMA: return ",";
         case TK_STRING: return "STRING";
         case TK_FLOAT: return "FLOAT";
+        case TK_INT: return "INT";
+        case TK_UINT: return "UINT";
         case TK_TRUE: return "TRUE";
         case TK_FALSE: return "FALSE";
         case TK_NULL: return "NULL";
@@ -97,6 +143,8 @@ const char *GetJsonKind(Json_Kind kind) {
         case JK_ARRAY: return "ARRAY";
         case JK_STRING: return "STRING";
         case JK_FLOAT: return "FLOAT";
+        case JK_INT: return "INT";
+        case JK_UINT: return "UINT";
         case JK_BOOLEAN: return "BOOLEAN";
         case JK_NULL: return "NULL";
         default: return "INVALID";
@@ -104,19 +152,199 @@ const char *GetJsonKind(Json_Kind kind) {
 }
 
 
-bool is_integer(char c) {
-    return c >= '0' && c <='9';
+#define JSON_ARENA_MIN_CHUNK (64*1024)
+#define JSON_ARENA_MAX_CHUNK (64*1024*1024)
+#define JSON_ARENA_ALIGN 16
+
+// Every node, copied key and decoded string of a document lives in one arena,
+// so the whole document is released with a single arena_reset/arena_free.
+typedef struct Json_Arena_Chunk {
+    struct Json_Arena_Chunk *next;
+    size_t count;
+    size_t capacity;
+    _Alignas(JSON_ARENA_ALIGN) char data[];
+} Json_Arena_Chunk;
+
+typedef struct {
+    Json_Arena_Chunk *first;
+    Json_Arena_Chunk *current;
+    // size of the next chunk to allocate, doubled after every new chunk
+    size_t chunk_size;
+} Json_Arena;
+
+Json_Arena_Chunk *arena_new_chunk(size_t capacity) {
+    Json_Arena_Chunk *c = malloc(sizeof(Json_Arena_Chunk) + capacity);
+    NOB_ASSERT(c != NULL && "Buy more RAM lol");
+    c->next = NULL;
+    c->count = 0;
+    c->capacity = capacity;
+    return c;
+}
+
+// Chunks are created lazily; `capacity_hint` only sizes the first one.
+Json_Arena arena_init(size_t capacity_hint) {
+    Json_Arena a = {0};
+    a.chunk_size = capacity_hint < JSON_ARENA_MIN_CHUNK ? JSON_ARENA_MIN_CHUNK : capacity_hint;
+    return a;
+}
+
+// A parsed document takes roughly twice the size of its text (nodes plus
+// decoded strings), so sizing the first chunk from the input length usually
+// means the whole document fits in a single chunk.
+Json_Arena arena_for_input(size_t input_len) {
+    return arena_init(input_len*2);
+}
+
+void *arena_alloc(Json_Arena *a, size_t size) {
+    size = (size + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
+    if (a->chunk_size == 0) a->chunk_size = JSON_ARENA_MIN_CHUNK;
+
+    // after an arena_reset the old chunks are still chained after `current`
+    while (a->current && a->current->count + size > a->current->capacity) {
+        if (!a->current->next) break;
+        a->current = a->current->next;
+    }
+
+    if (!a->current || a->current->count + size > a->current->capacity) {
+        size_t capacity = a->chunk_size;
+        if (capacity < size) capacity = size;
+        Json_Arena_Chunk *c = arena_new_chunk(capacity);
+        if (a->current) {
+            c->next = a->current->next;
+            a->current->next = c;
+        } else {
+            a->first = c;
+        }
+        a->current = c;
+        if (a->chunk_size < JSON_ARENA_MAX_CHUNK) a->chunk_size *= 2;
+    }
+
+    void *p = a->current->data + a->current->count;
+    a->current->count += size;
+    return p;
+}
+
+char *arena_strndup(Json_Arena *a, const char *s, size_t n) {
+    char *p = arena_alloc(a, n + 1);
+    memcpy(p, s, n);
+    p[n] = '\0';
+    return p;
+}
+
+// Forgets everything allocated so far but keeps the chunks for the next document.
+void arena_reset(Json_Arena *a) {
+    for (Json_Arena_Chunk *c = a->first; c; c = c->next) {
+        c->count = 0;
+    }
+    a->current = a->first;
+}
+
+void arena_free(Json_Arena *a) {
+    Json_Arena_Chunk *c = a->first;
+    while (c) {
+        Json_Arena_Chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    a->first = NULL;
+    a->current = NULL;
+}
+
+// Bytes after the end of every Json_Input that are guaranteed to be readable,
+// so vector kernels can load whole registers at the end of the document.
+#define JSON_PADDING JSON_BLOCK_SIZE
+
+// A view of the whole document as Tokenize and the parser see it, either
+// memory-mapped or read into memory.
+typedef struct {
+    const char *data;
+    size_t count;
+
+    // owned by the input, released by json_input_release
+    void *mapping;
+    size_t mapping_size;
+    char *buffer;
+} Json_Input;
+
+// Takes over the contents of a string builder, making room for the padding.
+Json_Input json_input_from_sb(Nob_String_Builder *sb) {
+    nob_da_reserve(sb, sb->count + JSON_PADDING);
+    memset(sb->items + sb->count, 0, JSON_PADDING);
+    Json_Input in = { .data = sb->items, .count = sb->count, .buffer = sb->items };
+    *sb = (Nob_String_Builder){0};
+    return in;
+}
+
+// Maps the file read-only instead of copying it, so parsing can start on the
+// first pages while the kernel reads ahead. The mapping is one anonymous
+// zero-filled region with the file mapped over its beginning, which is what
+// gives the padding after the last byte of the file.
+bool json_input_map_file(const char *path, Json_Input *in) {
+    memset(in, 0, sizeof(*in));
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "Could not open file %s: %s", path, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        nob_log(NOB_ERROR, "Could not stat file %s: %s", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    if (size > 0 && S_ISREG(st.st_mode)) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t total = (size + JSON_PADDING + page - 1)/page*page;
+        void *base = mmap(NULL, total, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base != MAP_FAILED) {
+            if (mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED) {
+                madvise(base, size, MADV_SEQUENTIAL);
+                madvise(base, size, MADV_WILLNEED);
+                close(fd);
+                in->data = base;
+                in->count = size;
+                in->mapping = base;
+                in->mapping_size = total;
+                return true;
+            }
+            munmap(base, total);
+        }
+        nob_log(NOB_WARNING, "Could not map file %s, reading it instead: %s", path, strerror(errno));
+    }
+    close(fd);
+#endif
+    // pipes, empty files and platforms without mmap
+    Nob_String_Builder sb = {0};
+    if (!nob_read_entire_file(path, &sb)) return false;
+    *in = json_input_from_sb(&sb);
+    return true;
+}
+
+void json_input_release(Json_Input *in) {
+#ifndef _WIN32
+    if (in->mapping) munmap(in->mapping, in->mapping_size);
+#endif
+    free(in->buffer);
+    memset(in, 0, sizeof(*in));
 }
 
-bool is_valid_char_for_string(char c) {
-    return c >= 32 && c <= 126;
+bool match_literal(Json_Input in, size_t At, const char *literal) {
+    size_t n = strlen(literal);
+    return At + n <= in.count && memcmp(in.data + At, literal, n) == 0;
 }
 
-Token GetToken(Nob_String_Builder sb, size_t *At) {
+Token GetToken(Json_Input in, size_t *At) {
+    const Json_Kernels *kernels = json_kernels();
     Token t = {0};
     t.kind = TK_NONE;
-    while (*At < sb.count) {
-        char c = sb.items[*At];
+    while (*At < in.count) {
+        *At = kernels->skip_whitespace(in.data, in.count, *At);
+        if (*At >= in.count) break;
+        char c = in.data[*At];
+        t.text = nob_sv_from_parts(in.data + *At, 1);
         switch (c) {
             case '{': t.kind = TK_OPEN_CURLY_BRACE; break;
             case '}': t.kind = TK_CLOSE_CURLY_BRACE; break;
@@ -126,122 +354,73 @@ Token GetToken(Nob_String_Builder sb, size_t *At) {
             case ',': t.kind = TK_COMMA; break;
             case 'n': 
                       {
-                          if (sb.items[*At-1] != '\\') {
-                              if (sb.items[*At+1] == 'u' &&
-                                      sb.items[*At+2] == 'l' &&
-                                      sb.items[*At+3] == 'l') {
-                                  t.kind = TK_NULL;
-                              }
+                          if (match_literal(in, *At, "null")) {
+                              t.kind = TK_NULL;
+                              t.text.count = 4;
+                              *At += 3;
                           }
                       } break;
             case 't': 
                       {
-                          if (sb.items[*At+1] == 'r' &&
-                                  sb.items[*At+2] == 'u' &&
-                                  sb.items[*At+3] == 'e') {
+                          if (match_literal(in, *At, "true")) {
                               t.kind = TK_TRUE;
+                              t.text.count = 4;
+                              *At += 3;
                           }
                       } break;
             case 'f': 
                       {
-                          if (sb.items[*At+1] == 'a' &&
-                                  sb.items[*At+2] == 'l' &&
-                                  sb.items[*At+3] == 's' &&
-                                  sb.items[*At+4] == 'e') {
+                          if (match_literal(in, *At, "false")) {
                               t.kind = TK_FALSE;
+                              t.text.count = 5;
+                              *At += 4;
                           }
                       } break;
-                      // if newline, just skip over the character
-            case '\r':
-            case '\n': break;
             case '"': 
                        {
-                           *At += 1;
-                           c = sb.items[*At];
-                           char *buffer = malloc(sizeof(char)*2048);
-                           size_t idx = 0;
-                           while (*At < sb.count && is_valid_char_for_string(c)) {
-                               if (c == '\\') {
-                                   if (*At + 1 < sb.count && sb.items[*At+1] == '"') {
-                                       buffer[idx] = c;
-                                       idx += 1;
-                                       *At += 1;
-                                       c = sb.items[*At];
-                                   }
-                               } else if (c == '"') {
-                                   break;
-                               }
-                               buffer[idx] = c;
-                               idx += 1;
-                               *At += 1;
-                               c = sb.items[*At];
+                           size_t start = *At + 1;
+                           size_t end = start;
+                           bool escaped = false;
+                           for (;;) {
+                               end = kernels->find_string_end(in.data, in.count, end);
+                               if (end >= in.count || in.data[end] == '"') break;
+                               // skip whatever is escaped, an escaped quote included
+                               escaped = true;
+                               end += 2;
+                           }
+                           if (end >= in.count) {
+                               nob_log(NOB_ERROR, "Unterminated string starting at byte %zu", *At);
+                               *At = in.count;
+                               return t;
                            }
                            t.kind = TK_STRING;
-                           t.text = buffer;
+                           t.text = nob_sv_from_parts(in.data + start, end - start);
+                           t.escaped = escaped;
+                           *At = end;
                        } break;
             default: 
                        {
-                           bool is_numeric = false;
-                           char *buffer = malloc(sizeof(char)*2048);
-                           size_t idx = 0;
-
-                           /*check for positive whole number*/
-                           if (is_integer(c)) 
-                           {
-                               is_numeric = true;
-                           } else if (c == '-' && (
-                                             (*At+1 < sb.count && sb.items[*At+1] == '.') &&
-                                             (*At+2 < sb.count && is_integer(sb.items[*At+2]))
-                                            ))
-                           /*check for negative float without initial 0*/
-                           {
-                               is_numeric = true;
-                               buffer[idx] = c;
-                               *At += 1;
-                               idx += 1;
-                               c = sb.items[*At];
-                               buffer[idx] = c;
-                               *At += 1;
-                               idx += 1;
-                               c = sb.items[*At];
-                           } else if (c == '-' && (*At+1 < sb.count && is_integer(sb.items[*At+1]))) 
-                            /*check for negative whole number*/
-                           {
-                                   is_numeric = true;
-                                   buffer[idx] = c;
-                                   *At += 1;
-                                   idx += 1;
-                                   c = sb.items[*At];
-                            } else if (c == '.' && (*At+1 < sb.count && is_integer(sb.items[*At+1]))) 
-                            /*check for positive float without initial 0*/
-                            {
-                                       is_numeric = true;
-                                       buffer[idx] = c;
-                                       *At += 1;
-                                       idx += 1;
-                                       c = sb.items[*At];
-                            }
-
-                           if (is_numeric) {
-                               while (*At < sb.count && 
-                                       (
-                                        is_integer(c) ||
-                                        (
-                                         c == '.' && *At+1 < sb.count && is_integer(sb.items[*At+1])
-                                        )
-                                       )
-                                     ) {
-                                   buffer[idx] = c;
-                                   idx += 1;
-                                   *At += 1;
-                                   c = sb.items[*At];
+                           Json_Number number;
+                           size_t len = json_parse_number(in.data + *At, in.count - *At, &number);
+                           if (len > 0) {
+                               switch (number.kind) {
+                                   case JSON_NUMBER_INT:
+                                       t.kind = TK_INT;
+                                       t.integer = number.integer;
+                                       break;
+                                   case JSON_NUMBER_UINT:
+                                       t.kind = TK_UINT;
+                                       t.uinteger = number.uinteger;
+                                       break;
+                                   case JSON_NUMBER_DOUBLE:
+                                       t.kind = TK_FLOAT;
+                                       t.num = number.num;
+                                       break;
                                }
-                               if (c == ',')
-                                   *At -= 1;
-                               t.kind = TK_FLOAT;
-                               t.num = (float)atof(buffer);
+                               t.text.count = len;
+                               *At += len - 1;
                            }
-                    }
+                       }
         }
 
         *At += 1;
@@ -251,296 +430,3670 @@ Token GetToken(Nob_String_Builder sb, size_t *At) {
     return t;
 }
 
-Tokens Tokenize(Nob_String_Builder sb) {
-    Tokens tokens = {0};
-    size_t At = 0;
-    Token t = GetToken(sb, &At);
-    while (t.kind != TK_NONE) {
-        nob_da_append(&tokens, t);
-        t = GetToken(sb, &At);
+bool json__is_delimiter(char c) {
+    switch (c) {
+        case ' ': case '\t': case '\n': case '\r':
+        case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+            return true;
+        default:
+            return false;
     }
+}
 
-    return tokens;
+// Offset of the first byte GetToken did not account for when it was called
+// at `start` and the next token starts at `next`, or SIZE_MAX when there is
+// none. GetToken skips bytes it cannot read and stops a number or literal at
+// the first byte that does not fit, so without this `[12abc]`, `[truex]` and
+// `[01]` would come out as `[12]`, `[true]` and `[1]`.
+size_t TokenJunk(Json_Input in, size_t start, Token t, size_t At, size_t next) {
+    if (t.kind == TK_NONE || At > next) return start;
+    // strings keep their text without the opening quote
+    size_t offset = (size_t)(t.text.data - in.data) - (t.kind == TK_STRING ? 1 : 0);
+    if (offset != start) return start;
+    size_t rest = json_kernels()->skip_whitespace(in.data, next, At);
+    return rest < next ? rest : SIZE_MAX;
 }
 
-Json_Element *GetNextNode(Json_Element *root) {
-    if (!root->next && root->kind == JK_NONE)
-        return root;
-    if (root->kind == JK_OBJECT)
-        return GetNextNode(root->value.object);
-    if (root->kind == JK_ARRAY)
-        return GetNextNode(root->value.array);
-    Json_Element *n = root->next;
-    while (n) {
-        if ((n->kind == JK_OBJECT || n->kind == JK_ARRAY) && n->open) {
-            return GetNextNode(n);
-        }
-        if (!n->next)
-            break;
-        n = n->next;
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool parse_hex4(Nob_String_View sv, size_t at, uint32_t *out) {
+    if (at + 4 > sv.count) return false;
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        int d = hex_digit(sv.data[at + i]);
+        if (d < 0) return false;
+        value = (value << 4) | (uint32_t)d;
     }
-    return n;
+    *out = value;
+    return true;
 }
 
-Json_Element ParseTokens(Tokens tokens) {
-    Json_Element root = {0};
+size_t encode_utf8(char *out, uint32_t cp) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    } else if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    } else if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    } else {
+        out[0] = (char)(0xF0 | (cp >> 18));
+        out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[3] = (char)(0x80 | (cp & 0x3F));
+        return 4;
+    }
+}
 
-    for (size_t i = 0; i < tokens.count; ++i) {
-        Token t = tokens.items[i];
-        Json_Element *tail = GetNextNode(&root);
-        switch (t.kind) {
-            case TK_NONE: 
-            {
-                nob_log(NOB_ERROR, "Invalid Token kind: TK_NONE!");
-                return root;
-            } break;
-            case TK_OPEN_CURLY_BRACE: 
-            {
-                tail->kind = JK_OBJECT;
-                tail->open = true;
-                Json_Element *j = malloc(sizeof(Json_Element));
-                memset(j, 0, sizeof(Json_Element));
-                j->open = true;
-                tail->value.object = j;
-                Json_Element *j2 = malloc(sizeof(Json_Element));
-                memset(j2, 0, sizeof(Json_Element));
-                j2->open = true;
-                tail->value.object->next = j2;
-            } break;
-            case TK_CLOSE_CURLY_BRACE: 
-            {
-                if (tail->kind == JK_OBJECT) {
-                    tail->open = false;
-                }
-            } break;
-            case TK_OPEN_SQ_BRACKET:
-            {
-               tail->kind = JK_ARRAY;
-               tail->open = true;
-               Json_Element *j = malloc(sizeof(Json_Element));
-               memset(j, 0, sizeof(Json_Element));
-               j->open = true;
-               tail->value.array = j;
-            } break;
-            case TK_CLOSE_SQ_BRACKET:
+// Decodes a raw string (as found between the quotes in the input) into `out`,
+// which must have room for at least `sv.count` bytes: decoding never makes a
+// string longer. Returns false on a malformed escape sequence.
+bool UnescapeStringTo(Nob_String_View sv, char *out, size_t *out_len) {
+    size_t i = 0;
+    size_t n = 0;
+    while (i < sv.count) {
+        // copy everything up to the next escape in one go
+        size_t run = i;
+        while (run < sv.count && sv.data[run] != '\\') run += 1;
+        memcpy(out + n, sv.data + i, run - i);
+        n += run - i;
+        i = run;
+        if (i >= sv.count) break;
+
+        if (i + 1 >= sv.count) return false;
+        char e = sv.data[i + 1];
+        i += 2;
+        switch (e) {
+            case '"':  out[n++] = '"';  break;
+            case '\\': out[n++] = '\\'; break;
+            case '/':  out[n++] = '/';  break;
+            case 'b':  out[n++] = '\b'; break;
+            case 'f':  out[n++] = '\f'; break;
+            case 'n':  out[n++] = '\n'; break;
+            case 'r':  out[n++] = '\r'; break;
+            case 't':  out[n++] = '\t'; break;
+            case 'u':
             {
-                if (tail->kind == JK_ARRAY) {
-                    tail->open = false;
+                uint32_t cp;
+                if (!parse_hex4(sv, i, &cp)) return false;
+                i += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    uint32_t lo;
+                    if (i + 1 < sv.count && sv.data[i] == '\\' && sv.data[i + 1] == 'u' &&
+                            parse_hex4(sv, i + 2, &lo) && lo >= 0xDC00 && lo <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        i += 6;
+                    } else {
+                        // lone high surrogate
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    // lone low surrogate
+                    cp = 0xFFFD;
                 }
+                n += encode_utf8(out + n, cp);
             } break;
-            case TK_COLON:  break; // do i need to do anything here?
-            case TK_COMMA: break; // do i need to do anything here?
-            case TK_STRING: 
-            {
-                if (tail->key) {
-                    tail->kind = JK_STRING;
-                    tail->value.text = t.text;
-                    tail->open = false;
-                   
-                    Json_Element *n = malloc(sizeof(Json_Element));
-                    memset(n, 0, sizeof(Json_Element));
-                    n->open = true;
-                    tail->next = n;
+            default: return false;
+        }
+    }
+    *out_len = n;
+    return true;
+}
 
-                } else {
-                    tail->key = t.text;
-                    tail->open = true;
-                }
-            } break;
-            case TK_FLOAT: 
-            {
-                if (tail->key) {
-                    tail->kind = JK_FLOAT;
-                    tail->value.num = t.num;
-                    tail->open = false;
-                    Json_Element *n = malloc(sizeof(Json_Element));
-                    memset(n, 0, sizeof(Json_Element));
-                    n->open = true;
-                    tail->next = n;
+// Same as UnescapeStringTo but appends the decoded text to a string builder.
+bool UnescapeString(Nob_String_View sv, Nob_String_Builder *out) {
+    nob_da_reserve(out, out->count + sv.count);
+    size_t n = 0;
+    if (!UnescapeStringTo(sv, out->items + out->count, &n)) return false;
+    out->count += n;
+    return true;
+}
 
-                }
-            } break;
-            case TK_TRUE: 
-            {
-                if (tail->key) {
-                    tail->kind = JK_BOOLEAN;
-                    tail->value.boolean = true;
-                    tail->open = false;
-                    Json_Element *n = malloc(sizeof(Json_Element));
-                    memset(n, 0, sizeof(Json_Element));
-                    n->open = true;
-                    tail->next = n;
+// Returns the decoded text of a string token as a null-terminated string
+// allocated in `arena`, and its length in `len` unless that is NULL. This is
+// the only place token text gets copied.
+char *GetTokenText(Json_Arena *arena, Token t, size_t *len) {
+    char *text = arena_alloc(arena, t.text.count + 1);
+    size_t n = t.text.count;
+    if (!t.escaped) {
+        memcpy(text, t.text.data, n);
+    } else if (!UnescapeStringTo(t.text, text, &n)) {
+        nob_log(NOB_ERROR, "Invalid escape sequence in string \""SV_Fmt"\"", SV_Arg(t.text));
+        n = t.text.count;
+        memcpy(text, t.text.data, n);
+    }
+    text[n] = '\0';
+    if (len) *len = n;
+    return text;
+}
 
-                }
-            } break;
-            case TK_FALSE: 
-            {
-                if (tail->key) {
-                    tail->kind = JK_BOOLEAN;
-                    tail->value.boolean = false;
-                    tail->open = false;
-                    Json_Element *n = malloc(sizeof(Json_Element));
-                    memset(n, 0, sizeof(Json_Element));
-                    n->open = true;
-                    tail->next = n;
+// Receives every token in input order; return false to stop. `t.text` points
+// into the input and, for streamed input, is only valid until the callback
+// returns.
+typedef bool (*Json_Token_Callback)(Token t, void *user);
 
+// Scans the whole input and hands every token to `callback` as it is found,
+// without collecting them. Returns false when the callback stopped the scan or
+// the input is malformed; the scan stops at the first bad token.
+bool TokenizeEach(Json_Input in, Json_Token_Callback callback, void *user) {
+    Json_Structurals structurals = {0};
 
-                }
-            } break;
-            case TK_NULL: 
-            {
-                if (tail->key) {
-                    tail->kind = JK_NULL;
-                    tail->open = false;
-                    Json_Element *n = malloc(sizeof(Json_Element));
-                    memset(n, 0, sizeof(Json_Element));
-                    n->open = true;
-                    tail->next = n;
+    if (!json_kernels()->validate_utf8(in.data, in.count)) {
+        nob_log(NOB_ERROR, "Input is not valid UTF-8");
+        return false;
+    }
 
+    bool ok = true;
+    if (json_find_structurals(in.data, in.count, &structurals)) {
+        // every structural position is the start of exactly one token, so
+        // GetToken never has to look at whitespace or string contents
+        for (size_t i = 0; ok && i < structurals.count; ++i) {
+            size_t start = structurals.items[i];
+            size_t next = i + 1 < structurals.count ? structurals.items[i + 1] : in.count;
+            size_t At = start;
+            Token t = GetToken(in, &At);
+            size_t junk = TokenJunk(in, start, t, At, next);
+            if (junk != SIZE_MAX) {
+                nob_log(NOB_ERROR, "Unexpected character '%c' at byte %zu", in.data[junk], junk);
+                ok = false;
+                break;
+            }
+            ok = callback(t, user);
+        }
+    } else {
+        // unterminated string or an input too big for the index, the plain
+        // scanner reports the former
+        const Json_Kernels *kernels = json_kernels();
+        size_t At = kernels->skip_whitespace(in.data, in.count, 0);
+        while (ok && At < in.count) {
+            size_t start = At;
+            Token t = GetToken(in, &At);
+            if (t.kind == TK_NONE) {
+                // GetToken reports unterminated strings itself
+                if (in.data[start] != '"') {
+                    nob_log(NOB_ERROR, "Unexpected character '%c' at byte %zu", in.data[start], start);
                 }
-            } break;
-            default: break;
-            
+                ok = false;
+                break;
+            }
+            // a number or literal runs up to the next delimiter
+            size_t next = At;
+            if (!json__is_delimiter(in.data[start])) {
+                while (next < in.count && !json__is_delimiter(in.data[next])) next += 1;
+            }
+            size_t junk = TokenJunk(in, start, t, At, next);
+            if (junk != SIZE_MAX) {
+                nob_log(NOB_ERROR, "Unexpected character '%c' at byte %zu", in.data[junk], junk);
+                ok = false;
+                break;
+            }
+            ok = callback(t, user);
+            At = kernels->skip_whitespace(in.data, in.count, At);
+        }
+    }
+
+    json_structurals_free(&structurals);
+    return ok;
+}
+
+bool AppendToken(Token t, void *user) {
+    nob_da_append((Tokens *)user, t);
+    return true;
+}
+
+// Appends every token of the input to `tokens`. Returns false when the input
+// is malformed; `tokens` then ends before the bad token.
+bool Tokenize(Json_Input in, Tokens *tokens) {
+    return TokenizeEach(in, AppendToken, tokens);
+}
+
+// Fixed-size queue of tokens from a tokenizer thread to one consumer thread,
+// so tokens can be used while the input is still being scanned and without
+// ever holding all of them. Both sides keep a private copy of the other
+// side's index and only reload it when that copy says the ring is full or
+// empty, and the producer publishes its writes JSON_TOKEN_RING_BATCH tokens
+// at a time, so the shared indexes move about once per batch instead of once
+// per token. Every group of fields is on its own cache line by who writes it.
+typedef struct {
+    Token *items;
+    // a power of two
+    size_t capacity;
+
+    // producer: published tail, then its private state
+    _Alignas(JSON_CACHE_LINE) atomic_size_t tail;
+    size_t write;
+    size_t head_cache;
+
+    // consumer: head, then its private state
+    _Alignas(JSON_CACHE_LINE) atomic_size_t head;
+    size_t tail_cache;
+
+    // set by the producer when done or by the consumer when it gives up
+    _Alignas(JSON_CACHE_LINE) atomic_bool closed;
+} Json_Token_Ring;
+
+#define JSON_TOKEN_RING_BATCH 64
+#define JSON_TOKEN_RING_CAPACITY 4096
+
+// `capacity` is rounded up to a power of two of at least two batches.
+void json_token_ring_init(Json_Token_Ring *ring, size_t capacity) {
+    memset(ring, 0, sizeof(*ring));
+    ring->capacity = 2*JSON_TOKEN_RING_BATCH;
+    while (ring->capacity < capacity) ring->capacity *= 2;
+    ring->items = malloc(ring->capacity*sizeof(*ring->items));
+    NOB_ASSERT(ring->items != NULL && "Buy more RAM lol");
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->closed, false);
+}
+
+void json_token_ring_free(Json_Token_Ring *ring) {
+    free(ring->items);
+    memset(ring, 0, sizeof(*ring));
+}
+
+// Makes every pushed token visible to the consumer.
+void json_token_ring_flush(Json_Token_Ring *ring) {
+    atomic_store_explicit(&ring->tail, ring->write, memory_order_release);
+}
+
+// Producer side. Waits while the ring is full; false once the consumer has
+// closed it.
+bool json_token_ring_push(Json_Token_Ring *ring, Token t) {
+    if (ring->write - ring->head_cache == ring->capacity) {
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (ring->write - ring->head_cache == ring->capacity) {
+            // the consumer may be waiting for the unpublished part
+            json_token_ring_flush(ring);
+            unsigned spins = 0;
+            while (ring->write - ring->head_cache == ring->capacity) {
+                if (atomic_load_explicit(&ring->closed, memory_order_acquire)) return false;
+                json_backoff(&spins);
+                ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+            }
         }
     }
+    ring->items[ring->write & (ring->capacity - 1)] = t;
+    ring->write += 1;
+    if (ring->write % JSON_TOKEN_RING_BATCH == 0) {
+        json_token_ring_flush(ring);
+        if (atomic_load_explicit(&ring->closed, memory_order_relaxed)) return false;
+    }
+    return true;
+}
 
-    return root;
+// Either side: the producer after its last push, the consumer to stop the
+// producer early.
+void json_token_ring_close(Json_Token_Ring *ring) {
+    atomic_store_explicit(&ring->closed, true, memory_order_release);
 }
 
-const char* str_repeat(char* str, size_t times) {
-    if (times < 1) return NULL;
-    char *ret = malloc(sizeof(str) * times + 1);
-    if (ret == NULL) return NULL;
-    strcpy(ret, str);
-    while (--times > 0) {
-        strcat(ret, str);
+// Consumer side. Copies up to `max` tokens into `out`, waiting while the ring
+// is empty. Returns 0 once the ring is closed and drained.
+size_t json_token_ring_pop(Json_Token_Ring *ring, Token *out, size_t max) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head == ring->tail_cache) {
+        unsigned spins = 0;
+        for (;;) {
+            // read before the tail, so a close seen here covers every push
+            bool closed = atomic_load_explicit(&ring->closed, memory_order_acquire);
+            ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire);
+            if (head != ring->tail_cache) break;
+            if (closed) return 0;
+            json_backoff(&spins);
+        }
     }
-    return ret;
+    size_t n = ring->tail_cache - head;
+    if (n > max) n = max;
+    for (size_t i = 0; i < n; ++i) out[i] = ring->items[(head + i) & (ring->capacity - 1)];
+    atomic_store_explicit(&ring->head, head + n, memory_order_release);
+    return n;
 }
 
-void Append2Json(Nob_String_Builder *sb, const char* text, size_t indent_amount) {
-    if (PRETTY_PRINT) {
-        const char* spaces = str_repeat(" ", indent_amount);
-        if (spaces) {
-            nob_sb_appendf(sb, "%s%s", spaces, text);
-        } else {
-            nob_sb_appendf(sb, "%s", text);
+#ifndef _WIN32
+typedef struct {
+    Json_Input in;
+    Json_Token_Ring *ring;
+    // what TokenizeEach returned, read after the join
+    bool ok;
+} Token_Ring_Producer;
+
+bool PushTokenToRing(Token t, void *user) {
+    return json_token_ring_push(user, t);
+}
+
+void *TokenRingProducer(void *arg) {
+    Token_Ring_Producer *producer = arg;
+    producer->ok = TokenizeEach(producer->in, PushTokenToRing, producer->ring);
+    json_token_ring_flush(producer->ring);
+    json_token_ring_close(producer->ring);
+    return NULL;
+}
+#endif // _WIN32
+
+// TokenizeEach with the scan on a thread of its own: tokens go through a
+// Json_Token_Ring of `capacity` tokens (0 for JSON_TOKEN_RING_CAPACITY) and
+// `callback` runs on the calling thread while the input is still being
+// scanned. Returns false when the callback stopped or the input is
+// malformed, like TokenizeEach.
+bool TokenizeEachThreaded(Json_Input in, size_t capacity, Json_Token_Callback callback, void *user) {
+#ifndef _WIN32
+    Json_Token_Ring ring;
+    json_token_ring_init(&ring, capacity ? capacity : JSON_TOKEN_RING_CAPACITY);
+    Token_Ring_Producer producer = { .in = in, .ring = &ring };
+    pthread_t thread;
+    // pthread_create returns the error instead of setting errno
+    int rc = pthread_create(&thread, NULL, TokenRingProducer, &producer);
+    if (rc != 0) {
+        nob_log(NOB_WARNING, "Could not start tokenizer thread, tokenizing on this one: %s", strerror(rc));
+        json_token_ring_free(&ring);
+        return TokenizeEach(in, callback, user);
+    }
+
+    bool ok = true;
+    Token batch[JSON_TOKEN_RING_BATCH];
+    size_t n;
+    while (ok && (n = json_token_ring_pop(&ring, batch, JSON_TOKEN_RING_BATCH)) > 0) {
+        for (size_t i = 0; ok && i < n; ++i) ok = callback(batch[i], user);
+    }
+    // stops the producer if the callback gave up
+    json_token_ring_close(&ring);
+    pthread_join(thread, NULL);
+    json_token_ring_free(&ring);
+    return ok && producer.ok;
+#else
+    (void)capacity;
+    return TokenizeEach(in, callback, user);
+#endif
+}
+
+// Below this many bytes per slice, threads cost more than they save.
+#define JSON_PARALLEL_MIN_SLICE (1024*1024)
+
+// One slice of a parallel stage-1 scan.
+typedef struct {
+    Json_Input in;
+    size_t start;
+    size_t end;
+    Json_Slice_Structurals scan;
+    bool ok;
+    // filled in after the prefix pass for the stitching task
+    bool inside;
+    Json_Structurals *out;
+    size_t at;
+} Structurals_Slice;
+
+void ScanStructuralsSlice(void *arg) {
+    Structurals_Slice *slice = arg;
+    slice->ok = json_find_structurals_slice(slice->in.data, slice->in.count, slice->start, slice->end, &slice->scan);
+}
+
+void StitchStructuralsSlice(void *arg) {
+    Structurals_Slice *slice = arg;
+    const Json_Structurals *chosen = slice->inside ? &slice->scan.inside : &slice->scan.outside;
+    if (chosen->count == 0) return;
+    memcpy(slice->out->items + slice->at, chosen->items, chosen->count*sizeof(*chosen->items));
+}
+
+// Splits the input into about `per_thread` slices per pool thread, each a
+// multiple of JSON_BLOCK_SIZE and at least JSON_PARALLEL_MIN_SLICE bytes.
+// Returns the slice size.
+size_t ParallelSliceSize(const Json_Pool *pool, size_t len, size_t per_thread) {
+    size_t slices = (pool->count > 0 ? pool->count : 1)*per_thread;
+    size_t size = (len + slices - 1)/slices;
+    if (size < JSON_PARALLEL_MIN_SLICE) size = JSON_PARALLEL_MIN_SLICE;
+    return (size + JSON_BLOCK_SIZE - 1)/JSON_BLOCK_SIZE*JSON_BLOCK_SIZE;
+}
+
+// json_find_structurals on the threads of `pool`, with the same result. Every
+// slice is scanned speculatively for both start states at once; a prefix pass
+// over the slices' quote parities then picks the real state of each, and the
+// chosen indexes are copied next to each other into `out`.
+bool FindStructuralsParallel(Json_Pool *pool, Json_Input in, Json_Structurals *out) {
+    if (pool->count < 2 || in.count >= UINT32_MAX) return json_find_structurals(in.data, in.count, out);
+    size_t size = ParallelSliceSize(pool, in.count, 4);
+    size_t count = (in.count + size - 1)/size;
+    if (count < 2) return json_find_structurals(in.data, in.count, out);
+
+    Structurals_Slice *slices = calloc(count, sizeof(*slices));
+    NOB_ASSERT(slices != NULL && "Buy more RAM lol");
+    Json_Wait_Group group;
+    json_wait_group_init(&group);
+    for (size_t i = 0; i < count; ++i) {
+        slices[i].in = in;
+        slices[i].start = i*size;
+        slices[i].end = i + 1 < count ? (i + 1)*size : in.count;
+        json_pool_submit(pool, &group, ScanStructuralsSlice, &slices[i]);
+    }
+    json_wait_group_wait(pool, &group);
+
+    bool ok = true;
+    bool inside = false;
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        ok = ok && slices[i].ok;
+        slices[i].inside = inside;
+        slices[i].out = out;
+        slices[i].at = total;
+        total += inside ? slices[i].scan.inside.count : slices[i].scan.outside.count;
+        inside ^= slices[i].scan.flips;
+    }
+    // the input ends inside a string
+    ok = ok && !inside;
+
+    out->count = 0;
+    if (ok && total > out->capacity) {
+        uint32_t *items = realloc(out->items, total*sizeof(*out->items));
+        NOB_ASSERT(items != NULL && "Buy more RAM lol");
+        out->items = items;
+        out->capacity = total;
+    }
+    if (ok) {
+        for (size_t i = 0; i < count; ++i) json_pool_submit(pool, &group, StitchStructuralsSlice, &slices[i]);
+        json_wait_group_wait(pool, &group);
+        out->count = total;
+    }
+
+    json_wait_group_destroy(&group);
+    for (size_t i = 0; i < count; ++i) {
+        json_structurals_free(&slices[i].scan.outside);
+        json_structurals_free(&slices[i].scan.inside);
+    }
+    free(slices);
+    return ok;
+}
+
+typedef struct {
+    const char *data;
+    size_t start;
+    size_t end;
+    bool ok;
+} Utf8_Slice;
+
+void ValidateUtf8Slice(void *arg) {
+    Utf8_Slice *slice = arg;
+    slice->ok = json_kernels()->validate_utf8(slice->data + slice->start, slice->end - slice->start);
+}
+
+// Moves a slice boundary back to the start of the UTF-8 sequence it falls
+// into. More than three continuation bytes are invalid anyway, and the slice
+// that starts on one reports it.
+size_t Utf8Boundary(Json_Input in, size_t At) {
+    for (size_t i = 0; i < 3 && At > 0 && At < in.count && ((unsigned char)in.data[At] & 0xC0) == 0x80; ++i) At -= 1;
+    return At;
+}
+
+// Stage 2 over a run of structurals: the tokens of structurals[from, to).
+typedef struct {
+    Json_Input in;
+    const Json_Structurals *structurals;
+    size_t from;
+    size_t to;
+    Tokens tokens;
+    // offset of the first byte that does not belong to a token or SIZE_MAX,
+    // logged by the caller so only the first one in input order comes out
+    size_t junk;
+} Token_Slice;
+
+void TokenizeSlice(void *arg) {
+    Token_Slice *slice = arg;
+    const Json_Structurals *structurals = slice->structurals;
+    slice->junk = SIZE_MAX;
+    for (size_t i = slice->from; i < slice->to; ++i) {
+        size_t start = structurals->items[i];
+        size_t next = i + 1 < structurals->count ? structurals->items[i + 1] : slice->in.count;
+        size_t At = start;
+        Token t = GetToken(slice->in, &At);
+        size_t junk = TokenJunk(slice->in, start, t, At, next);
+        if (junk != SIZE_MAX) {
+            slice->junk = junk;
+            break;
         }
-    } else {
-        nob_sb_appendf(sb, "%s", text);
+        nob_da_append(&slice->tokens, t);
     }
 }
 
+// Tokenize on the threads of `pool`: UTF-8 validation and the structural
+// scan run over slices of the input, then the structurals are cut into runs
+// that become tokens in parallel, and the runs are joined in order. The
+// tokens, messages and result are the same as Tokenize's. Small inputs and
+// inputs the index cannot cover are tokenized on the calling thread.
+bool TokenizeParallel(Json_Pool *pool, Json_Input in, Tokens *tokens) {
+    size_t size = ParallelSliceSize(pool, in.count, 4);
+    if (pool->count < 2 || in.count >= UINT32_MAX || in.count <= size) return Tokenize(in, tokens);
 
-Nob_String_Builder Tokens2Json(Tokens tokens) {
-    Nob_String_Builder sb = {0};
-    size_t indent_amount = 0;
+    size_t count = (in.count + size - 1)/size;
+    Utf8_Slice *utf8 = calloc(count, sizeof(*utf8));
+    NOB_ASSERT(utf8 != NULL && "Buy more RAM lol");
+    Json_Wait_Group utf8_group;
+    json_wait_group_init(&utf8_group);
+    for (size_t i = 0; i < count; ++i) {
+        utf8[i].data = in.data;
+        utf8[i].start = Utf8Boundary(in, i*size);
+        utf8[i].end = i + 1 < count ? Utf8Boundary(in, (i + 1)*size) : in.count;
+        json_pool_submit(pool, &utf8_group, ValidateUtf8Slice, &utf8[i]);
+    }
 
-    for (size_t i = 0; i < tokens.count; ++i) {
-        Token t = tokens.items[i];
-        switch (t.kind) {
-            case TK_OPEN_CURLY_BRACE: 
-                {
-                    Append2Json(&sb, "{", indent_amount);
-                    nob_da_append(&sb, '\n');
-                    indent_amount += SPACES_FOR_INDENT;
-                } break;
-            case TK_CLOSE_CURLY_BRACE: 
-                {
-                    indent_amount -= SPACES_FOR_INDENT;
-                    if (sb.items[sb.count] != '\n')
-                        nob_da_append(&sb, '\n');
-                    Append2Json(&sb, "}", indent_amount);
-                    nob_da_append(&sb, '\n');
-                } break;
-            case TK_OPEN_SQ_BRACKET: 
-                {
-                    Append2Json(&sb, "[", indent_amount);
-                    indent_amount += SPACES_FOR_INDENT;
-                    nob_da_append(&sb, '\n');
-                } break;
-            case TK_CLOSE_SQ_BRACKET: 
-                {
-                    indent_amount -= SPACES_FOR_INDENT;
-                    Append2Json(&sb, "]", indent_amount);
-                    nob_da_append(&sb, '\n');
-                } break;
-            case TK_STRING: 
-                {
-                    char buff[strlen(t.text)];
-                    sprintf(buff, "\"%s\"", t.text);
-                    Append2Json(&sb, (const char *)buff, indent_amount);
-                } break;
-            case TK_FLOAT: 
-                {
-                    char buff[100];
-                    sprintf(buff, "%f", t.num);
-                    Append2Json(&sb, (const char *)buff, 0);
-                } break;
-            case TK_COLON: 
-                {
-                    Append2Json(&sb, ": ", 0);
-                } break;
-            case TK_COMMA: 
-                {
-                    Append2Json(&sb, ",", 0);
-                    nob_da_append(&sb, '\n');
-                } break;
-            case TK_NULL: 
-                {
-                    Append2Json(&sb, "null", 0);
-                } break;
-            case TK_TRUE: 
-                {
-                    Append2Json(&sb, "true", 0);
-                } break;
-            case TK_FALSE: 
-                {
-                    Append2Json(&sb, "false", 0);
-                } break;
-            default: nob_log(NOB_ERROR, "Unknown token: %s", GetTokenKind(t.kind));
+    // validation keeps running on the pool while the structurals are found
+    Json_Structurals structurals = {0};
+    bool indexed = FindStructuralsParallel(pool, in, &structurals);
+    json_wait_group_wait(pool, &utf8_group);
+    json_wait_group_destroy(&utf8_group);
+    bool valid = true;
+    for (size_t i = 0; i < count; ++i) valid = valid && utf8[i].ok;
+    free(utf8);
+
+    bool ok = valid;
+    if (!valid) {
+        nob_log(NOB_ERROR, "Input is not valid UTF-8");
+    } else if (!indexed) {
+        // unterminated string, the plain scanner reports it
+        ok = Tokenize(in, tokens);
+    } else {
+        size_t runs = count;
+        size_t per_run = (structurals.count + runs - 1)/runs;
+        Token_Slice *slices = calloc(runs, sizeof(*slices));
+        NOB_ASSERT(slices != NULL && "Buy more RAM lol");
+        Json_Wait_Group group;
+        json_wait_group_init(&group);
+        for (size_t i = 0; i < runs; ++i) {
+            slices[i].in = in;
+            slices[i].structurals = &structurals;
+            slices[i].from = i*per_run < structurals.count ? i*per_run : structurals.count;
+            slices[i].to = slices[i].from + per_run < structurals.count ? slices[i].from + per_run : structurals.count;
+            json_pool_submit(pool, &group, TokenizeSlice, &slices[i]);
         }
+        json_wait_group_wait(pool, &group);
+        json_wait_group_destroy(&group);
+
+        size_t total = 0;
+        for (size_t i = 0; i < runs; ++i) total += slices[i].tokens.count;
+        nob_da_reserve(tokens, tokens->count + total);
+        // like Tokenize, stop at the first bad token
+        for (size_t i = 0; i < runs; ++i) {
+            if (ok && slices[i].tokens.count > 0) {
+                memcpy(tokens->items + tokens->count, slices[i].tokens.items, slices[i].tokens.count*sizeof(Token));
+                tokens->count += slices[i].tokens.count;
+            }
+            if (ok && slices[i].junk != SIZE_MAX) {
+                size_t junk = slices[i].junk;
+                nob_log(NOB_ERROR, "Unexpected character '%c' at byte %zu", in.data[junk], junk);
+                ok = false;
+            }
+            nob_da_free(slices[i].tokens);
+        }
+        free(slices);
     }
 
-    return sb;
+    json_structurals_free(&structurals);
+    return ok;
 }
 
-int main() {
+// Tokenizer for input that arrives in pieces: reads from a pipe or socket, or
+// files too big to hold in memory. Only the bytes of a token that is split
+// across a chunk boundary are carried over, so memory is bounded by the chunk
+// size plus the longest single token instead of by the document.
+typedef struct {
+    // the unfinished token from the previous chunks followed by the newest one
+    Nob_String_Builder buffer;
+    // how far into `buffer` the unfinished token has been scanned, so a long
+    // string is not searched again from its start on every chunk
+    size_t scanned;
+    // stream offset of buffer.items[0], for error messages
+    size_t offset;
+    // the callback asked to stop or the input was malformed
+    bool stopped;
+} Json_Stream;
 
-    //const char *filePath = "./data/nasa.json";
-    const char *filePath = "./data/weather.json";
+#define JSON_STREAM_CHUNK_SIZE (64*1024)
 
-    Nob_String_Builder sb = {0};
-    if (!nob_read_entire_file(filePath, &sb)) return 1;
+// Finds the end of the token starting at `At`. Returns false when the token
+// runs into the end of the buffer and may continue in the next chunk.
+bool StreamTokenEnd(Json_Input in, size_t At, size_t *scanned, size_t *end) {
+    const char c = in.data[At];
+    if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',') {
+        *end = At + 1;
+        return true;
+    }
+    size_t i = *scanned > At ? *scanned : At;
+    if (c == '"') {
+        if (i == At) i += 1;
+        for (;;) {
+            i = json_kernels()->find_string_end(in.data, in.count, i);
+            if (i >= in.count) break;
+            if (in.data[i] == '"') {
+                *end = i + 1;
+                return true;
+            }
+            // stop before a backslash whose escaped byte has not arrived yet,
+            // the scan has to resume on it
+            if (i + 1 >= in.count) break;
+            i += 2;
+        }
+        *scanned = i;
+        return false;
+    }
+    while (i < in.count && !json__is_delimiter(in.data[i])) i += 1;
+    *scanned = i;
+    *end = i;
+    return i < in.count;
+}
 
-    Tokens tokens = Tokenize(sb);
+// Emits every complete token in the buffer and keeps the unfinished one for
+// the next chunk. With `last` set nothing more is coming, so a number or
+// literal that touches the end is complete and an open string is an error.
+bool StreamTokens(Json_Stream *s, bool last, Json_Token_Callback callback, void *user) {
+    const Json_Kernels *kernels = json_kernels();
+    Json_Input in = { .data = s->buffer.items, .count = s->buffer.count };
+    size_t At = 0;
+    while (!s->stopped) {
+        At = kernels->skip_whitespace(in.data, in.count, At);
+        if (At >= in.count) break;
 
-    //Json_Element root = ParseTokens(tokens);
+        size_t end = in.count;
+        if (!StreamTokenEnd(in, At, &s->scanned, &end)) {
+            if (!last) break;
+            if (in.data[At] == '"') {
+                nob_log(NOB_ERROR, "Unterminated string starting at byte %zu", s->offset + At);
+                s->stopped = true;
+                break;
+            }
+        }
 
-    //nob_log(NOB_INFO, "%s", root.key);
+        size_t start = At;
+        Token t = GetToken(in, &At);
+        s->scanned = 0;
+        size_t junk = TokenJunk(in, start, t, At, end);
+        if (junk != SIZE_MAX) {
+            nob_log(NOB_ERROR, "Unexpected character '%c' at byte %zu", in.data[junk], s->offset + junk);
+            s->stopped = true;
+            break;
+        }
+        if (t.kind == TK_STRING && !kernels->validate_utf8(t.text.data, t.text.count)) {
+            nob_log(NOB_ERROR, "Input is not valid UTF-8 in string at byte %zu", s->offset + start);
+            s->stopped = true;
+            break;
+        }
+        if (!callback(t, user)) s->stopped = true;
+    }
 
-    Nob_String_Builder result = Tokens2Json(tokens);
+    // move the unfinished token to the front for the next chunk
+    size_t consumed = At < in.count ? At : in.count;
+    memmove(s->buffer.items, s->buffer.items + consumed, s->buffer.count - consumed);
+    s->buffer.count -= consumed;
+    s->scanned = s->scanned > consumed ? s->scanned - consumed : 0;
+    s->offset += consumed;
+    return !s->stopped;
+}
 
-    FILE *fp = fopen("./dump.json", "w");
-    fprintf(fp, "%s", result.items);
-    fclose(fp);
+// Tokenizes the next `len` bytes of the stream. Tokens can be split at any
+// byte. Returns false once the callback stopped or the input turned out to be
+// malformed; further chunks are ignored from then on.
+bool json_stream_feed(Json_Stream *s, const char *chunk, size_t len, Json_Token_Callback callback, void *user) {
+    if (s->stopped) return false;
+    nob_da_reserve(&s->buffer, s->buffer.count + len + JSON_PADDING);
+    memcpy(s->buffer.items + s->buffer.count, chunk, len);
+    s->buffer.count += len;
+    memset(s->buffer.items + s->buffer.count, 0, JSON_PADDING);
+    return StreamTokens(s, false, callback, user);
+}
 
-#if 0
-    FILE *fp = fopen("./info.txt", "w");
-    for (size_t i = 0; i < tokens.count; ++i) {
-        Token t = tokens.items[i];
-        if (t.kind != TK_STRING && t.kind != TK_FLOAT)
-            fprintf(fp, "%s\n", GetTokenKind(t.kind));
-        if (t.text && strlen(t.text) > 0) {
-            fprintf(fp, "%s\n", t.text);
-        } if (t.num > 0) {
-            fprintf(fp, "%f\n", t.num);
+// Flushes the token at the very end of the input, if there is one.
+bool json_stream_finish(Json_Stream *s, Json_Token_Callback callback, void *user) {
+    if (s->stopped) return false;
+    if (s->buffer.count == 0) return true;
+    nob_da_reserve(&s->buffer, s->buffer.count + JSON_PADDING);
+    memset(s->buffer.items + s->buffer.count, 0, JSON_PADDING);
+    return StreamTokens(s, true, callback, user);
+}
+
+void json_stream_free(Json_Stream *s) {
+    nob_da_free(s->buffer);
+    memset(s, 0, sizeof(*s));
+}
+
+// Reads `path` in fixed-size chunks and feeds it through a Json_Stream.
+bool TokenizeStream(const char *path, size_t chunk_size, Json_Token_Callback callback, void *user) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        nob_log(NOB_ERROR, "Could not open file %s: %s", path, strerror(errno));
+        return false;
+    }
+    char *chunk = malloc(chunk_size);
+    NOB_ASSERT(chunk != NULL && "Buy more RAM lol");
+
+    Json_Stream s = {0};
+    bool ok = true;
+    for (;;) {
+        size_t n = fread(chunk, 1, chunk_size, f);
+        if (n > 0 && !json_stream_feed(&s, chunk, n, callback, user)) {
+            ok = false;
+            break;
         }
-        //fprintf(fp, "--------------------------\n");
+        if (n < chunk_size) break;
+    }
+    if (ferror(f)) {
+        nob_log(NOB_ERROR, "Could not read file %s: %s", path, strerror(errno));
+        ok = false;
+    } else if (ok) {
+        ok = json_stream_finish(&s, callback, user);
     }
 
-    fclose(fp);
-#endif
+    json_stream_free(&s);
+    free(chunk);
+    fclose(f);
+    return ok;
+}
 
-    return 0;
+// Event interface for consumers that only need a few fields: the handlers are
+// called while the input is scanned and nothing is built. Strings and keys are
+// views of the input with escapes left in place (`escaped` says whether
+// UnescapeString is needed), so pulling values out does not allocate. The
+// escapes are checked before the handler sees the view, so UnescapeString
+// cannot fail on it. Any handler can be NULL; returning false from one aborts
+// the parse.
+typedef struct {
+    bool (*on_object_begin)(void *user);
+    bool (*on_object_end)(void *user);
+    bool (*on_array_begin)(void *user);
+    bool (*on_array_end)(void *user);
+    bool (*on_key)(void *user, Nob_String_View key, bool escaped);
+    bool (*on_string)(void *user, Nob_String_View text, bool escaped);
+    // `text` is the number as written, `number` its parsed value
+    bool (*on_number)(void *user, Nob_String_View text, Json_Number number);
+    bool (*on_bool)(void *user, bool value);
+    bool (*on_null)(void *user);
+} Json_Sax_Handlers;
+
+typedef enum {
+    SAX_EXPECT_VALUE,
+    // right after '[', so ']' is allowed as well
+    SAX_EXPECT_VALUE_OR_END,
+    SAX_EXPECT_KEY,
+    // right after '{', so '}' is allowed as well
+    SAX_EXPECT_KEY_OR_END,
+    SAX_EXPECT_COLON,
+    SAX_EXPECT_COMMA_OR_END,
+} Sax_Expect;
+
+// Grammar state between tokens, so the same checks run over a whole input and
+// over a Json_Stream. Several top-level values in a row are accepted, which is
+// what NDJSON looks like to the tokenizer.
+typedef struct {
+    const Json_Sax_Handlers *handlers;
+    void *user;
+    // '{' or '[' for every open container
+    Nob_String_Builder stack;
+    // escaped strings are decoded here to check them
+    Nob_String_Builder scratch;
+    Sax_Expect expect;
+    // a handler returned false
+    bool aborted;
+    // the input is not well-formed JSON
+    bool failed;
+} Json_Sax;
+
+#define SAX_CALL(sax, handler, ...) \
+    ((sax)->handlers->handler == NULL || (sax)->handlers->handler((sax)->user, ##__VA_ARGS__))
+
+// What comes after a complete value depends on what it is nested in.
+void SaxValueDone(Json_Sax *sax) {
+    sax->expect = sax->stack.count > 0 ? SAX_EXPECT_COMMA_OR_END : SAX_EXPECT_VALUE;
+}
+
+bool SaxError(Json_Sax *sax, Token t) {
+    nob_log(NOB_ERROR, "Unexpected token \""SV_Fmt"\"", SV_Arg(t.text));
+    sax->failed = true;
+    return false;
+}
+
+bool SaxCheckEscapes(Json_Sax *sax, Token t) {
+    if (!t.escaped) return true;
+    sax->scratch.count = 0;
+    if (UnescapeString(t.text, &sax->scratch)) return true;
+    nob_log(NOB_ERROR, "Invalid escape sequence in string \""SV_Fmt"\"", SV_Arg(t.text));
+    sax->failed = true;
+    return false;
+}
+
+// Grammar state between tokens for the code that does not go through
+// SaxToken: the tree parser and the token writers. Same rules, no handlers.
+typedef struct {
+    Sax_Expect expect;
+    // '{' or '[' for every open container
+    Nob_String_Builder open;
+} Json_Grammar;
+
+// Checks a `kind` token against the grammar and moves the state past it.
+// `is_key` (when not NULL) says whether the token was an object key. Logs and
+// returns false when the token cannot come next.
+bool GrammarStep(Json_Grammar *g, Token_Kind kind, bool *is_key) {
+    char top = g->open.count > 0 ? g->open.items[g->open.count - 1] : 0;
+    bool key = false;
+    bool ok = false;
+    switch (g->expect) {
+        case SAX_EXPECT_COLON:
+            ok = kind == TK_COLON;
+            break;
+        case SAX_EXPECT_COMMA_OR_END:
+            ok = kind == TK_COMMA || kind == TK_CLOSE_CURLY_BRACE || kind == TK_CLOSE_SQ_BRACKET;
+            break;
+        case SAX_EXPECT_KEY_OR_END:
+            if (kind == TK_CLOSE_CURLY_BRACE) {
+                ok = true;
+                break;
+            }
+            // fallthrough
+        case SAX_EXPECT_KEY:
+            ok = key = kind == TK_STRING;
+            break;
+        case SAX_EXPECT_VALUE_OR_END:
+            if (kind == TK_CLOSE_SQ_BRACKET) {
+                ok = true;
+                break;
+            }
+            // fallthrough
+        case SAX_EXPECT_VALUE:
+            ok = kind != TK_NONE && kind != TK_COLON && kind != TK_COMMA &&
+                 kind != TK_CLOSE_CURLY_BRACE && kind != TK_CLOSE_SQ_BRACKET;
+            break;
+    }
+    if (kind == TK_CLOSE_CURLY_BRACE) ok = ok && top == '{';
+    if (kind == TK_CLOSE_SQ_BRACKET) ok = ok && top == '[';
+    if (!ok) {
+        nob_log(NOB_ERROR, "Unexpected %s", GetTokenKind(kind));
+        return false;
+    }
+
+    switch (kind) {
+        case TK_OPEN_CURLY_BRACE:
+            nob_da_append(&g->open, '{');
+            g->expect = SAX_EXPECT_KEY_OR_END;
+            break;
+        case TK_OPEN_SQ_BRACKET:
+            nob_da_append(&g->open, '[');
+            g->expect = SAX_EXPECT_VALUE_OR_END;
+            break;
+        case TK_COLON:
+            g->expect = SAX_EXPECT_VALUE;
+            break;
+        case TK_COMMA:
+            g->expect = top == '{' ? SAX_EXPECT_KEY : SAX_EXPECT_VALUE;
+            break;
+        default:
+            if (kind == TK_CLOSE_CURLY_BRACE || kind == TK_CLOSE_SQ_BRACKET) g->open.count -= 1;
+            if (key) {
+                g->expect = SAX_EXPECT_COLON;
+            } else {
+                g->expect = g->open.count > 0 ? SAX_EXPECT_COMMA_OR_END : SAX_EXPECT_VALUE;
+            }
+            break;
+    }
+    if (is_key) *is_key = key;
+    return true;
+}
+
+// Checks that the input did not stop inside a value and releases the state.
+bool GrammarEnd(Json_Grammar *g) {
+    bool ok = g->open.count == 0 && g->expect == SAX_EXPECT_VALUE;
+    if (!ok) nob_log(NOB_ERROR, "Unexpected end of input: %zu containers are still open", g->open.count);
+    nob_da_free(g->open);
+    g->open = (Nob_String_Builder){0};
+    return ok;
+}
+
+// Checks that a whole token array is well-formed JSON, for writers that work
+// on the tokens without parsing them.
+bool CheckTokens(Tokens tokens) {
+    Json_Grammar g = {0};
+    bool ok = true;
+    for (size_t i = 0; ok && i < tokens.count; ++i) ok = GrammarStep(&g, tokens.items[i].kind, NULL);
+    return GrammarEnd(&g) && ok;
+}
+
+// Json_Token_Callback that turns tokens into handler calls; `user` is the
+// Json_Sax.
+bool SaxToken(Token t, void *user) {
+    Json_Sax *sax = user;
+    bool ok = true;
+    char top = sax->stack.count > 0 ? sax->stack.items[sax->stack.count - 1] : 0;
+
+    switch (sax->expect) {
+        case SAX_EXPECT_COLON:
+            if (t.kind != TK_COLON) return SaxError(sax, t);
+            sax->expect = SAX_EXPECT_VALUE;
+            return true;
+        case SAX_EXPECT_COMMA_OR_END:
+            if (t.kind == TK_COMMA) {
+                sax->expect = top == '{' ? SAX_EXPECT_KEY : SAX_EXPECT_VALUE;
+                return true;
+            }
+            if (t.kind == TK_CLOSE_CURLY_BRACE && top == '{') goto close;
+            if (t.kind == TK_CLOSE_SQ_BRACKET && top == '[') goto close;
+            return SaxError(sax, t);
+        case SAX_EXPECT_KEY_OR_END:
+            if (t.kind == TK_CLOSE_CURLY_BRACE) goto close;
+            // fallthrough
+        case SAX_EXPECT_KEY:
+            if (t.kind != TK_STRING) return SaxError(sax, t);
+            if (!SaxCheckEscapes(sax, t)) return false;
+            ok = SAX_CALL(sax, on_key, t.text, t.escaped);
+            sax->expect = SAX_EXPECT_COLON;
+            break;
+        case SAX_EXPECT_VALUE_OR_END:
+            if (t.kind == TK_CLOSE_SQ_BRACKET) goto close;
+            // fallthrough
+        case SAX_EXPECT_VALUE:
+            switch (t.kind) {
+                case TK_OPEN_CURLY_BRACE:
+                    nob_da_append(&sax->stack, '{');
+                    ok = SAX_CALL(sax, on_object_begin);
+                    sax->expect = SAX_EXPECT_KEY_OR_END;
+                    break;
+                case TK_OPEN_SQ_BRACKET:
+                    nob_da_append(&sax->stack, '[');
+                    ok = SAX_CALL(sax, on_array_begin);
+                    sax->expect = SAX_EXPECT_VALUE_OR_END;
+                    break;
+                case TK_STRING:
+                    if (!SaxCheckEscapes(sax, t)) return false;
+                    ok = SAX_CALL(sax, on_string, t.text, t.escaped);
+                    SaxValueDone(sax);
+                    break;
+                case TK_FLOAT:
+                case TK_INT:
+                case TK_UINT:
+                    {
+                        Json_Number number = {0};
+                        if (t.kind == TK_FLOAT) {
+                            number.kind = JSON_NUMBER_DOUBLE;
+                            number.num = t.num;
+                        } else if (t.kind == TK_INT) {
+                            number.kind = JSON_NUMBER_INT;
+                            number.integer = t.integer;
+                        } else {
+                            number.kind = JSON_NUMBER_UINT;
+                            number.uinteger = t.uinteger;
+                        }
+                        ok = SAX_CALL(sax, on_number, t.text, number);
+                        SaxValueDone(sax);
+                    } break;
+                case TK_TRUE:
+                case TK_FALSE:
+                    ok = SAX_CALL(sax, on_bool, t.kind == TK_TRUE);
+                    SaxValueDone(sax);
+                    break;
+                case TK_NULL:
+                    ok = SAX_CALL(sax, on_null);
+                    SaxValueDone(sax);
+                    break;
+                default:
+                    return SaxError(sax, t);
+            }
+            break;
+    }
+    if (!ok) sax->aborted = true;
+    return ok;
+
+close:
+    sax->stack.count -= 1;
+    ok = top == '{' ? SAX_CALL(sax, on_object_end) : SAX_CALL(sax, on_array_end);
+    SaxValueDone(sax);
+    if (!ok) sax->aborted = true;
+    return ok;
+}
+
+// Checks that the input did not stop inside a value and releases the state.
+bool SaxEnd(Json_Sax *sax) {
+    bool ok = !sax->aborted && !sax->failed;
+    if (ok && (sax->stack.count > 0 || sax->expect != SAX_EXPECT_VALUE)) {
+        nob_log(NOB_ERROR, "Unexpected end of input inside %zu open container(s)", sax->stack.count);
+        ok = false;
+    }
+    nob_da_free(sax->stack);
+    sax->stack = (Nob_String_Builder){0};
+    nob_da_free(sax->scratch);
+    sax->scratch = (Nob_String_Builder){0};
+    return ok;
+}
+
+// Returns false when a handler aborted or the input is malformed.
+bool SaxParse(Json_Input in, const Json_Sax_Handlers *handlers, void *user) {
+    Json_Sax sax = { .handlers = handlers, .user = user };
+    bool ok = TokenizeEach(in, SaxToken, &sax);
+    // the tokenizer already said what was wrong
+    if (!ok) sax.failed = true;
+    return SaxEnd(&sax) && ok;
+}
+
+// Same as SaxParse, but reads `path` in chunks through a Json_Stream. The views
+// passed to the handlers are only valid during the call.
+bool SaxParseStream(const char *path, const Json_Sax_Handlers *handlers, void *user) {
+    Json_Sax sax = { .handlers = handlers, .user = user };
+    bool ok = TokenizeStream(path, JSON_STREAM_CHUNK_SIZE, SaxToken, &sax);
+    // the tokenizer already said what was wrong
+    if (!ok) sax.failed = true;
+    return SaxEnd(&sax) && ok;
+}
+
+// Index of the first token after the value that starts at `i`.
+size_t SkipValue(Tokens tokens, size_t i) {
+    Token_Kind kind = tokens.items[i].kind;
+    if (kind != TK_OPEN_CURLY_BRACE && kind != TK_OPEN_SQ_BRACKET) return i + 1;
+    size_t depth = 0;
+    for (; i < tokens.count; ++i) {
+        switch (tokens.items[i].kind) {
+            case TK_OPEN_CURLY_BRACE:
+            case TK_OPEN_SQ_BRACKET: depth += 1; break;
+            case TK_CLOSE_CURLY_BRACE:
+            case TK_CLOSE_SQ_BRACKET:
+                depth -= 1;
+                if (depth == 0) return i + 1;
+                break;
+            default: break;
+        }
+    }
+    return tokens.count;
+}
+
+typedef struct {
+    Json_Element *container;
+    // last child appended to `container`, so appending is O(1)
+    Json_Element *tail;
+    size_t count;
+    // projection node of the container, and how many elements of an array
+    // were seen, kept or not
+    size_t node;
+    size_t position;
+} Parse_Frame;
+
+typedef struct {
+    Parse_Frame *items;
+    size_t capacity;
+    size_t count;
+} Parse_Stack;
+
+Json_Element *NewElement(Json_Arena *arena) {
+    Json_Element *e = arena_alloc(arena, sizeof(Json_Element));
+    memset(e, 0, sizeof(Json_Element));
+    return e;
+}
+
+// Creates the node for a value and links it after the current tail of the
+// innermost open container (or makes it the root when nothing is open yet).
+Json_Element *AttachValue(Json_Arena *arena, Json_Element *root, Parse_Stack *stack, Nob_String_View *key, Json_Kind kind) {
+    Json_Element *e;
+    if (stack->count == 0) {
+        if (root->kind != JK_NONE) {
+            nob_log(NOB_ERROR, "Unexpected value after the end of the document");
+            return NULL;
+        }
+        e = root;
+    } else {
+        Parse_Frame *top = &nob_da_last(stack);
+        if (top->container->kind == JK_OBJECT) {
+            if (key->data == NULL) {
+                nob_log(NOB_ERROR, "Object member without a key");
+                return NULL;
+            }
+        }
+        e = NewElement(arena);
+        e->key = key->data;
+        e->key_len = key->count;
+        if (top->tail) {
+            top->tail->next = e;
+        } else {
+            top->container->value.object = e;
+        }
+        top->tail = e;
+        top->count += 1;
+    }
+    *key = (Nob_String_View){0};
+    e->kind = kind;
+    return e;
+}
+
+// Objects with at least this many members get an index header when they are
+// parsed, and the hash table itself is built on the first lookup. Smaller
+// objects are searched linearly, which is faster than hashing for them.
+#define JSON_INDEX_LAZY_MIN 16
+// From this many members on the table is built right away during the parse.
+#define JSON_INDEX_EAGER_MIN 1024
+
+typedef struct {
+    uint64_t hash;
+    Json_Element *member;
+} Json_Index_Slot;
+
+typedef struct Json_Object_Index {
+    // open addressing with linear probing over `mask + 1` slots, NULL until
+    // the table is built
+    Json_Index_Slot *slots;
+    size_t mask;
+    // the arena of the tree, where a lazily built table goes
+    Json_Arena *arena;
+} Json_Object_Index;
+
+// FNV-1a over the key bytes. Exposed so callers can hash keys they look up
+// often once, see json_object_get_hashed.
+uint64_t json_key_hash(const char *key, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)key[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Compares the key of object member `m` with `len` bytes of `key`.
+bool KeyEquals(const Json_Element *m, const char *key, size_t len) {
+    return m->key_len == len && (m->key == key || memcmp(m->key, key, len) == 0);
+}
+
+void BuildObjectIndex(Json_Element *obj) {
+    Json_Object_Index *index = obj->index;
+    size_t capacity = 16;
+    while (capacity < obj->count*2) capacity *= 2;
+    index->slots = arena_alloc(index->arena, capacity*sizeof(Json_Index_Slot));
+    memset(index->slots, 0, capacity*sizeof(Json_Index_Slot));
+    index->mask = capacity - 1;
+
+    for (Json_Element *m = obj->value.object; m; m = m->next) {
+        uint64_t hash = json_key_hash(m->key, m->key_len);
+        size_t i = hash & index->mask;
+        bool duplicate = false;
+        while (index->slots[i].member) {
+            // the first of duplicate keys wins, same as a linear search
+            if (index->slots[i].hash == hash && KeyEquals(index->slots[i].member, m->key, m->key_len)) {
+                duplicate = true;
+                break;
+            }
+            i = (i + 1) & index->mask;
+        }
+        if (!duplicate) {
+            index->slots[i].hash = hash;
+            index->slots[i].member = m;
+        }
+    }
+}
+
+// Called when an object is closed, once its member count is known.
+void IndexObject(Json_Arena *arena, Json_Element *obj) {
+    if (obj->count < JSON_INDEX_LAZY_MIN) return;
+    Json_Object_Index *index = arena_alloc(arena, sizeof(Json_Object_Index));
+    memset(index, 0, sizeof(*index));
+    index->arena = arena;
+    obj->index = index;
+    if (obj->count >= JSON_INDEX_EAGER_MIN) BuildObjectIndex(obj);
+}
+
+// Called when an array is closed: copies the element chain into a vector so
+// elements can be reached by position.
+void IndexArray(Json_Arena *arena, Json_Element *arr) {
+    if (arr->count == 0) return;
+    arr->items = arena_alloc(arena, arr->count*sizeof(Json_Element *));
+    size_t i = 0;
+    for (Json_Element *e = arr->value.array; e; e = e->next) arr->items[i++] = e;
+}
+
+typedef struct {
+    // NUL-terminated, owned by the Json_Context
+    const char *text;
+    size_t len;
+    uint64_t hash;
+} Json_Interned;
+
+// Canonical copies of every key seen by a context. The id of a key is its
+// position in `items`; `slots` maps hashes to id + 1 with linear probing.
+typedef struct {
+    Json_Interned *items;
+    size_t capacity;
+    size_t count;
+
+    uint32_t *slots;
+    size_t slot_count;
+} Json_Intern_Table;
+
+#define JSON_INTERN_NONE UINT32_MAX
+
+// State that outlives a single document. Reusing one context across the
+// documents of a stream stores every distinct key once, and keys of trees
+// parsed with the same context can be compared by pointer. Interning is not
+// thread-safe; give every thread its own context for that. The task pool is
+// the exception: any thread may submit to it.
+typedef struct {
+    Json_Intern_Table keys;
+    // interned key text lives here, not in the per-document arenas
+    Json_Arena strings;
+    // decoding buffer for escaped keys
+    Nob_String_Builder scratch;
+    // started on first use by json_context_pool, stopped by json_context_free
+    Json_Pool pool;
+    bool pool_started;
+} Json_Context;
+
+// The context's task pool, started with `threads` workers (0 for one per CPU)
+// the first time it is asked for; later calls reuse it whatever `threads` is.
+Json_Pool *json_context_pool(Json_Context *ctx, size_t threads) {
+    if (!ctx->pool_started) {
+        if (!json_pool_start(&ctx->pool, threads)) {
+            nob_log(NOB_WARNING, "Could not start worker threads, running tasks on the calling thread");
+        }
+        ctx->pool_started = true;
+    }
+    return &ctx->pool;
+}
+
+void json_context_free(Json_Context *ctx) {
+    if (ctx->pool_started) json_pool_stop(&ctx->pool);
+    nob_da_free(ctx->keys);
+    free(ctx->keys.slots);
+    arena_free(&ctx->strings);
+    nob_sb_free(ctx->scratch);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+// Id of the key, or JSON_INTERN_NONE when the context has not seen it.
+uint32_t json_intern_find_hashed(const Json_Context *ctx, const char *key, size_t len, uint64_t hash) {
+    const Json_Intern_Table *t = &ctx->keys;
+    if (t->slot_count == 0) return JSON_INTERN_NONE;
+    size_t mask = t->slot_count - 1;
+    for (size_t i = hash & mask; t->slots[i]; i = (i + 1) & mask) {
+        const Json_Interned *k = &t->items[t->slots[i] - 1];
+        if (k->hash == hash && k->len == len && memcmp(k->text, key, len) == 0) return t->slots[i] - 1;
+    }
+    return JSON_INTERN_NONE;
+}
+
+uint32_t json_intern_find(const Json_Context *ctx, const char *key, size_t len) {
+    return json_intern_find_hashed(ctx, key, len, json_key_hash(key, len));
+}
+
+void InternTableGrow(Json_Intern_Table *t) {
+    size_t slot_count = t->slot_count ? t->slot_count*2 : 64;
+    uint32_t *slots = calloc(slot_count, sizeof(*slots));
+    NOB_ASSERT(slots != NULL && "Buy more RAM lol");
+    for (size_t id = 0; id < t->count; ++id) {
+        size_t i = t->items[id].hash & (slot_count - 1);
+        while (slots[i]) i = (i + 1) & (slot_count - 1);
+        slots[i] = (uint32_t)id + 1;
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->slot_count = slot_count;
+}
+
+// Id of the key, adding it to the context the first time it is seen.
+uint32_t json_intern_id(Json_Context *ctx, const char *key, size_t len) {
+    uint64_t hash = json_key_hash(key, len);
+    uint32_t id = json_intern_find_hashed(ctx, key, len, hash);
+    if (id != JSON_INTERN_NONE) return id;
+
+    Json_Intern_Table *t = &ctx->keys;
+    if ((t->count + 1)*2 > t->slot_count) InternTableGrow(t);
+    id = (uint32_t)t->count;
+    Json_Interned k = { arena_strndup(&ctx->strings, key, len), len, hash };
+    nob_da_append(t, k);
+    size_t i = hash & (t->slot_count - 1);
+    while (t->slots[i]) i = (i + 1) & (t->slot_count - 1);
+    t->slots[i] = id + 1;
+    return id;
+}
+
+// The canonical copy of the key; equal keys interned through the same context
+// always come back as the same pointer.
+const char *json_intern(Json_Context *ctx, const char *key, size_t len) {
+    uint32_t id = json_intern_id(ctx, key, len);
+    return ctx->keys.items[id].text;
+}
+
+// Compares a raw key token with decoded key bytes without allocating.
+bool RawKeyEquals(Nob_String_View raw, bool escaped, const char *key, size_t len) {
+    if (!escaped) return raw.count == len && memcmp(raw.data, key, len) == 0;
+    // decoding never makes a string longer
+    if (len > raw.count) return false;
+    char buffer[256];
+    if (raw.count > sizeof(buffer)) {
+        Nob_String_Builder sb = {0};
+        bool equal = UnescapeString(raw, &sb) && sb.count == len && memcmp(sb.items, key, len) == 0;
+        nob_sb_free(sb);
+        return equal;
+    }
+    size_t n = 0;
+    return UnescapeStringTo(raw, buffer, &n) && n == len && memcmp(buffer, key, len) == 0;
+}
+
+typedef struct {
+    // decoded member name
+    char *name;
+    size_t len;
+    // the step is a non-negative integer, so it can also select an array element
+    bool has_index;
+    size_t index;
+    // `*`: every member or element
+    bool wildcard;
+} Json_Path_Step;
+
+// A compiled JSON Pointer (RFC 6901) with `*` as a wildcard step, e.g.
+// "/data/items/*/temperature". Compile once and run it against any number of
+// documents.
+typedef struct {
+    Json_Path_Step *items;
+    size_t capacity;
+    size_t count;
+} Json_Path;
+
+void json_path_free(Json_Path *path) {
+    for (size_t i = 0; i < path->count; ++i) free(path->items[i].name);
+    nob_da_free(*path);
+    memset(path, 0, sizeof(*path));
+}
+
+bool json_path_compile(const char *pointer, Json_Path *out) {
+    memset(out, 0, sizeof(*out));
+    // "" is the whole document
+    if (*pointer == '\0') return true;
+    if (*pointer != '/') {
+        nob_log(NOB_ERROR, "JSON Pointer \"%s\" does not start with /", pointer);
+        return false;
+    }
+
+    const char *p = pointer + 1;
+    for (;;) {
+        size_t n = strcspn(p, "/");
+        Json_Path_Step step = {0};
+        step.name = malloc(n + 1);
+        NOB_ASSERT(step.name != NULL && "Buy more RAM lol");
+        for (size_t i = 0; i < n; ++i) {
+            char c = p[i];
+            if (c == '~') {
+                if (i + 1 < n && (p[i + 1] == '0' || p[i + 1] == '1')) {
+                    c = p[++i] == '0' ? '~' : '/';
+                } else {
+                    nob_log(NOB_ERROR, "Invalid escape in JSON Pointer \"%s\"", pointer);
+                    free(step.name);
+                    json_path_free(out);
+                    return false;
+                }
+            }
+            step.name[step.len++] = c;
+        }
+        step.name[step.len] = '\0';
+
+        step.wildcard = n == 1 && p[0] == '*';
+        // array indices have no leading zeros
+        if (step.len > 0 && step.len < 20 && (step.name[0] != '0' || step.len == 1)) {
+            step.has_index = true;
+            for (size_t i = 0; i < step.len; ++i) {
+                if (step.name[i] < '0' || step.name[i] > '9') step.has_index = false;
+                else step.index = step.index*10 + (size_t)(step.name[i] - '0');
+            }
+        }
+        nob_da_append(out, step);
+
+        if (p[n] == '\0') break;
+        p += n + 1;
+    }
+    return true;
+}
+
+// A set of paths to keep when parsing, merged into a trie of path steps.
+// Node 0 is the document root. A `*` step is merged into its named siblings,
+// so every value matches at most one child of a node.
+typedef struct {
+    Json_Path_Step step;
+    // a path ends here, the whole subtree is kept
+    bool keep;
+    // 0 when there is none, the root is never a child
+    size_t first_child;
+    size_t next_sibling;
+} Json_Projection_Node;
+
+typedef struct {
+    Json_Projection_Node *items;
+    size_t capacity;
+    size_t count;
+} Json_Projection;
+
+// Frame node of a subtree that is kept whole.
+#define JSON_PROJECTION_ALL SIZE_MAX
+
+bool ProjectionStepEquals(const Json_Path_Step *a, const Json_Path_Step *b) {
+    return a->wildcard == b->wildcard && a->len == b->len && memcmp(a->name, b->name, a->len) == 0;
+}
+
+size_t ProjectionNewChild(Json_Projection *p, size_t parent, const Json_Path_Step *step) {
+    Json_Projection_Node node = { .step = *step };
+    node.step.name = malloc(step->len + 1);
+    NOB_ASSERT(node.step.name != NULL && "Buy more RAM lol");
+    memcpy(node.step.name, step->name, step->len + 1);
+    node.next_sibling = p->items[parent].first_child;
+    size_t index = p->count;
+    nob_da_append(p, node);
+    p->items[parent].first_child = index;
+    return index;
+}
+
+// Copies the children of `from` (and everything below) under `to`.
+void ProjectionCopyChildren(Json_Projection *p, size_t from, size_t to) {
+    for (size_t c = p->items[from].first_child; c != 0; c = p->items[c].next_sibling) {
+        Json_Path_Step step = p->items[c].step;
+        size_t copy = ProjectionNewChild(p, to, &step);
+        p->items[copy].keep = p->items[c].keep;
+        ProjectionCopyChildren(p, c, copy);
+    }
+}
+
+void ProjectionInsert(Json_Projection *p, size_t node, const Json_Path *path, size_t step) {
+    if (p->items[node].keep) return;
+    if (step == path->count) {
+        p->items[node].keep = true;
+        return;
+    }
+
+    const Json_Path_Step *s = &path->items[step];
+    size_t match = 0, wildcard = 0;
+    for (size_t c = p->items[node].first_child; c != 0; c = p->items[c].next_sibling) {
+        if (ProjectionStepEquals(&p->items[c].step, s)) match = c;
+        if (p->items[c].step.wildcard) wildcard = c;
+    }
+
+    if (s->wildcard) {
+        // whatever is kept under `*` is also kept under every named sibling
+        for (size_t c = p->items[node].first_child; c != 0; c = p->items[c].next_sibling) {
+            if (!p->items[c].step.wildcard) ProjectionInsert(p, c, path, step + 1);
+        }
+        if (match == 0) match = ProjectionNewChild(p, node, s);
+    } else if (match == 0) {
+        match = ProjectionNewChild(p, node, s);
+        if (wildcard != 0) {
+            p->items[match].keep = p->items[wildcard].keep;
+            ProjectionCopyChildren(p, wildcard, match);
+        }
+    }
+    ProjectionInsert(p, match, path, step + 1);
+}
+
+// Adds a JSON Pointer (with `*` wildcards) to the set of paths to keep.
+bool json_projection_add(Json_Projection *p, const char *pointer) {
+    Json_Path path;
+    if (!json_path_compile(pointer, &path)) return false;
+    if (p->count == 0) {
+        Json_Projection_Node root = {0};
+        nob_da_append(p, root);
+    }
+    ProjectionInsert(p, 0, &path, 0);
+    json_path_free(&path);
+    return true;
+}
+
+void json_projection_free(Json_Projection *p) {
+    for (size_t i = 0; i < p->count; ++i) free(p->items[i].step.name);
+    nob_da_free(*p);
+    memset(p, 0, sizeof(*p));
+}
+
+// Node a value is matched against, given the node of its container: a member
+// key (`key` set) or an array position. 0 when the value is not kept.
+size_t ProjectionChild(const Json_Projection *p, size_t node, const Token *key, size_t position) {
+    if (node == JSON_PROJECTION_ALL) return JSON_PROJECTION_ALL;
+    size_t wildcard = 0;
+    for (size_t c = p->items[node].first_child; c != 0; c = p->items[c].next_sibling) {
+        const Json_Path_Step *s = &p->items[c].step;
+        bool match;
+        if (s->wildcard) {
+            wildcard = c;
+            continue;
+        } else if (key) {
+            match = RawKeyEquals(key->text, key->escaped, s->name, s->len);
+        } else {
+            match = s->has_index && s->index == position;
+        }
+        if (match) return p->items[c].keep ? JSON_PROJECTION_ALL : c;
+    }
+    if (wildcard != 0) return p->items[wildcard].keep ? JSON_PROJECTION_ALL : wildcard;
+    return 0;
+}
+
+typedef struct {
+    // when set, object keys are interned in the context instead of being
+    // copied into the document's arena
+    Json_Context *ctx;
+    // when set, only values on these paths get nodes; everything else is
+    // skipped at the token level
+    const Json_Projection *projection;
+} Json_Parse_Options;
+
+// Decoded text of a key token, interned when the parse has a context.
+Nob_String_View ParseKey(Json_Arena *arena, Json_Parse_Options opts, Token t) {
+    size_t len;
+    if (opts.ctx == NULL) {
+        const char *text = GetTokenText(arena, t, &len);
+        return nob_sv_from_parts(text, len);
+    }
+    if (!t.escaped) return nob_sv_from_parts(json_intern(opts.ctx, t.text.data, t.text.count), t.text.count);
+
+    Nob_String_Builder *scratch = &opts.ctx->scratch;
+    scratch->count = 0;
+    if (!UnescapeString(t.text, scratch)) {
+        nob_log(NOB_ERROR, "Invalid escape sequence in string \""SV_Fmt"\"", SV_Arg(t.text));
+        return nob_sv_from_parts(json_intern(opts.ctx, t.text.data, t.text.count), t.text.count);
+    }
+    return nob_sv_from_parts(json_intern(opts.ctx, scratch->items, scratch->count), scratch->count);
+}
+
+// The returned tree is owned by `arena`, except for keys interned in
+// `opts.ctx`, which live as long as the context. Returns NULL when the tokens
+// are not well-formed JSON, with the same checks as SaxParse; values the
+// projection drops are checked too.
+Json_Element *ParseTokensEx(Json_Arena *arena, Tokens tokens, Json_Parse_Options opts) {
+    Json_Element *root = NewElement(arena);
+    // containers that are kept, with their elements
+    Parse_Stack stack = {0};
+    // every open container, kept or dropped
+    Json_Grammar grammar = {0};
+    Nob_String_View key = {0};
+    // the member whose key was just read is not kept
+    bool drop_member = false;
+    // while a dropped container is open, the depth it started at
+    size_t drop = 0;
+    const Json_Projection *projection = opts.projection;
+    // projection node of the next value
+    size_t node = JSON_PROJECTION_ALL;
+    if (projection && projection->count > 0 && !projection->items[0].keep) node = 0;
+
+    for (size_t i = 0; i < tokens.count; ++i) {
+        Token t = tokens.items[i];
+        Json_Element *e = NULL;
+
+        bool is_key;
+        if (!GrammarStep(&grammar, t.kind, &is_key)) goto fail;
+        bool closes = t.kind == TK_CLOSE_CURLY_BRACE || t.kind == TK_CLOSE_SQ_BRACKET;
+        bool is_value = !is_key && t.kind != TK_COLON && t.kind != TK_COMMA && !closes;
+
+        if (drop > 0) {
+            if (grammar.open.count < drop) drop = 0;
+            continue;
+        }
+
+        // elements of a projected array are matched by position
+        bool dropped = false;
+        if (is_value && drop_member) {
+            drop_member = false;
+            dropped = true;
+        } else if (is_value && stack.count > 0 && nob_da_last(&stack).container->kind == JK_ARRAY) {
+            Parse_Frame *frame = &nob_da_last(&stack);
+            node = ProjectionChild(projection, frame->node, NULL, frame->position++);
+            dropped = node == 0;
+        }
+        if (dropped) {
+            if (t.kind == TK_OPEN_CURLY_BRACE || t.kind == TK_OPEN_SQ_BRACKET) drop = grammar.open.count;
+            continue;
+        }
+
+        switch (t.kind) {
+            case TK_OPEN_CURLY_BRACE: 
+            case TK_OPEN_SQ_BRACKET:
+            {
+                Json_Kind kind = t.kind == TK_OPEN_CURLY_BRACE ? JK_OBJECT : JK_ARRAY;
+                e = AttachValue(arena, root, &stack, &key, kind);
+                if (!e) goto fail;
+                e->open = true;
+                Parse_Frame frame = { .container = e, .tail = NULL, .node = node };
+                nob_da_append(&stack, frame);
+            } break;
+            case TK_CLOSE_CURLY_BRACE: 
+            case TK_CLOSE_SQ_BRACKET:
+            {
+                Parse_Frame *frame = &nob_da_last(&stack);
+                frame->container->open = false;
+                frame->container->count = frame->count;
+                if (frame->container->kind == JK_OBJECT) IndexObject(arena, frame->container);
+                else IndexArray(arena, frame->container);
+                stack.count -= 1;
+            } break;
+            case TK_STRING: 
+            {
+                if (is_key) {
+                    if (stack.count > 0) {
+                        node = ProjectionChild(projection, nob_da_last(&stack).node, &t, 0);
+                        if (node == 0) {
+                            // the member is not kept: its value is checked and dropped
+                            drop_member = true;
+                            continue;
+                        }
+                    }
+                    key = ParseKey(arena, opts, t);
+                } else {
+                    e = AttachValue(arena, root, &stack, &key, JK_STRING);
+                    if (!e) goto fail;
+                    e->value.text = GetTokenText(arena, t, &e->count);
+                }
+            } break;
+            case TK_FLOAT: 
+            {
+                e = AttachValue(arena, root, &stack, &key, JK_FLOAT);
+                if (!e) goto fail;
+                e->value.num = t.num;
+            } break;
+            case TK_INT: 
+            {
+                e = AttachValue(arena, root, &stack, &key, JK_INT);
+                if (!e) goto fail;
+                e->value.integer = t.integer;
+            } break;
+            case TK_UINT: 
+            {
+                e = AttachValue(arena, root, &stack, &key, JK_UINT);
+                if (!e) goto fail;
+                e->value.uinteger = t.uinteger;
+            } break;
+            case TK_TRUE: 
+            case TK_FALSE: 
+            {
+                e = AttachValue(arena, root, &stack, &key, JK_BOOLEAN);
+                if (!e) goto fail;
+                e->value.boolean = t.kind == TK_TRUE;
+            } break;
+            case TK_NULL: 
+            {
+                e = AttachValue(arena, root, &stack, &key, JK_NULL);
+                if (!e) goto fail;
+            } break;
+            default: break;
+            
+        }
+    }
+
+    nob_da_free(stack);
+    return GrammarEnd(&grammar) ? root : NULL;
+
+fail:
+    nob_da_free(stack);
+    nob_da_free(grammar.open);
+    return NULL;
+}
+
+// The returned tree, including all of its strings, is owned by `arena`. NULL
+// when the tokens are not well-formed JSON.
+Json_Element *ParseTokens(Json_Arena *arena, Tokens tokens) {
+    return ParseTokensEx(arena, tokens, (Json_Parse_Options){0});
+}
+
+// Member of `obj` called `key`, or NULL. Large objects are looked up through
+// their hash index, which is built here on first use; that makes the first
+// lookup on a mid-sized object not safe to run concurrently with others.
+Json_Element *json_object_get_hashed(Json_Element *obj, const char *key, size_t len, uint64_t hash) {
+    if (obj == NULL || obj->kind != JK_OBJECT) return NULL;
+
+    Json_Object_Index *index = obj->index;
+    if (index == NULL) {
+        // keys interned in the same context match by pointer
+        for (Json_Element *m = obj->value.object; m; m = m->next) {
+            if (KeyEquals(m, key, len)) return m;
+        }
+        return NULL;
+    }
+
+    if (index->slots == NULL) BuildObjectIndex(obj);
+    for (size_t i = hash & index->mask; index->slots[i].member; i = (i + 1) & index->mask) {
+        Json_Element *m = index->slots[i].member;
+        if (index->slots[i].hash == hash && KeyEquals(m, key, len)) return m;
+    }
+    return NULL;
+}
+
+Json_Element *json_object_get(Json_Element *obj, const char *key, size_t len) {
+    // small objects never look at the hash, so don't compute it for them
+    if (obj != NULL && obj->index == NULL) return json_object_get_hashed(obj, key, len, 0);
+    return json_object_get_hashed(obj, key, len, json_key_hash(key, len));
+}
+
+size_t json_array_len(const Json_Element *arr) {
+    if (arr == NULL || arr->kind != JK_ARRAY) return 0;
+    return arr->count;
+}
+
+// Element `i` of `arr`, or NULL when it is out of range.
+Json_Element *json_array_at(const Json_Element *arr, size_t i) {
+    if (arr == NULL || arr->kind != JK_ARRAY || i >= arr->count) return NULL;
+    return arr->items[i];
+}
+
+// On-demand access: the document is only indexed (stage 1 of Tokenize), and
+// values are found by walking that index. Nothing is allocated while
+// navigating, subtrees that are not asked for are skipped by bracket
+// matching, and strings and numbers are decoded only when read. Only the
+// parts that are visited are checked, so a malformed document can go
+// unnoticed until the broken part is reached.
+typedef struct {
+    Json_Input in;
+    // start of every token in the input
+    Json_Structurals structurals;
+} Json_Document;
+
+// A position in a Json_Document: the value whose first token is
+// `doc->structurals.items[index]`. Cheap to copy.
+typedef struct {
+    const Json_Document *doc;
+    size_t index;
+} Json_Cursor;
+
+bool json_document_init(Json_Document *doc, Json_Input in) {
+    memset(doc, 0, sizeof(*doc));
+    doc->in = in;
+    if (!json_kernels()->validate_utf8(in.data, in.count)) {
+        nob_log(NOB_ERROR, "Input is not valid UTF-8");
+        return false;
+    }
+    if (!json_find_structurals(in.data, in.count, &doc->structurals)) {
+        nob_log(NOB_ERROR, "Could not index the document");
+        return false;
+    }
+    return true;
+}
+
+void json_document_free(Json_Document *doc) {
+    json_structurals_free(&doc->structurals);
+    memset(doc, 0, sizeof(*doc));
+}
+
+// Cursor at the top-level value; false for an empty document.
+bool json_document_root(const Json_Document *doc, Json_Cursor *out) {
+    out->doc = doc;
+    out->index = 0;
+    return doc->structurals.count > 0;
+}
+
+// First byte of the token at structural `index`, 0 past the end.
+char CursorByte(const Json_Document *doc, size_t index) {
+    if (index >= doc->structurals.count) return 0;
+    return doc->in.data[doc->structurals.items[index]];
+}
+
+// Index of the first token after the value starting at `index`. Containers
+// are skipped by counting brackets in the index, their contents are never
+// looked at.
+size_t CursorSkip(const Json_Document *doc, size_t index) {
+    char c = CursorByte(doc, index);
+    if (c != '{' && c != '[') return index + 1;
+    size_t depth = 0;
+    for (; index < doc->structurals.count; ++index) {
+        switch (CursorByte(doc, index)) {
+            case '{':
+            case '[': depth += 1; break;
+            case '}':
+            case ']':
+                depth -= 1;
+                if (depth == 0) return index + 1;
+                break;
+            default: break;
+        }
+    }
+    return doc->structurals.count;
+}
+
+Json_Kind json_cursor_kind(Json_Cursor c) {
+    switch (CursorByte(c.doc, c.index)) {
+        case '{': return JK_OBJECT;
+        case '[': return JK_ARRAY;
+        case '"': return JK_STRING;
+        case 't':
+        case 'f': return JK_BOOLEAN;
+        case 'n': return JK_NULL;
+        case 0: return JK_NONE;
+        default:
+            {
+                Json_Number number;
+                size_t at = c.doc->structurals.items[c.index];
+                if (json_parse_number(c.doc->in.data + at, c.doc->in.count - at, &number) == 0) return JK_NONE;
+                switch (number.kind) {
+                    case JSON_NUMBER_INT: return JK_INT;
+                    case JSON_NUMBER_UINT: return JK_UINT;
+                    case JSON_NUMBER_DOUBLE: return JK_FLOAT;
+                }
+                return JK_NONE;
+            }
+    }
+}
+
+// The full token at the cursor, decoded by GetToken.
+Token CursorToken(Json_Cursor c) {
+    Token t = {0};
+    if (c.index >= c.doc->structurals.count) return t;
+    size_t start = c.doc->structurals.items[c.index];
+    size_t next = c.index + 1 < c.doc->structurals.count ? c.doc->structurals.items[c.index + 1] : c.doc->in.count;
+    size_t At = start;
+    t = GetToken(c.doc->in, &At);
+    if (TokenJunk(c.doc->in, start, t, At, next) != SIZE_MAX) t.kind = TK_NONE;
+    return t;
+}
+
+// Moves to the first element of an array or the value of the first member of
+// an object. False when the container is empty or `c` is not a container.
+bool json_cursor_first(Json_Cursor c, Json_Cursor *out) {
+    char open = CursorByte(c.doc, c.index);
+    if (open != '{' && open != '[') return false;
+    char first = CursorByte(c.doc, c.index + 1);
+    if (first == '}' || first == ']' || first == 0) return false;
+    out->doc = c.doc;
+    // members are key, colon, value
+    out->index = open == '{' ? c.index + 3 : c.index + 1;
+    return out->index < c.doc->structurals.count;
+}
+
+// Moves to the next element, or the value of the next member, in the same
+// container. False after the last one.
+bool json_cursor_next(Json_Cursor *c) {
+    size_t next = CursorSkip(c->doc, c->index);
+    if (CursorByte(c->doc, next) != ',') return false;
+    // in an object the value is preceded by its key and a colon
+    bool member = c->index >= 2 && CursorByte(c->doc, c->index - 1) == ':';
+    size_t index = member ? next + 3 : next + 1;
+    if (index >= c->doc->structurals.count) return false;
+    c->index = index;
+    return true;
+}
+
+// Raw (still escaped) key of the object member whose value is at `c`.
+Nob_String_View json_cursor_key(Json_Cursor c, bool *escaped) {
+    Token t = {0};
+    if (c.index >= 2 && CursorByte(c.doc, c.index - 1) == ':') {
+        t = CursorToken((Json_Cursor){ c.doc, c.index - 2 });
+    }
+    if (escaped) *escaped = t.escaped;
+    return t.kind == TK_STRING ? t.text : nob_sv_from_parts(NULL, 0);
+}
+
+// Finds the member `key` of the object at `c`, skipping every other member's
+// value without looking inside it.
+bool json_cursor_find(Json_Cursor c, const char *key, size_t len, Json_Cursor *out) {
+    if (CursorByte(c.doc, c.index) != '{') return false;
+    Json_Cursor member;
+    if (!json_cursor_first(c, &member)) return false;
+    do {
+        bool escaped;
+        Nob_String_View raw = json_cursor_key(member, &escaped);
+        if (RawKeyEquals(raw, escaped, key, len)) {
+            *out = member;
+            return true;
+        }
+    } while (json_cursor_next(&member));
+    return false;
+}
+
+// Element `i` of the array at `c`; the elements before it are skipped.
+bool json_cursor_at(Json_Cursor c, size_t i, Json_Cursor *out) {
+    if (CursorByte(c.doc, c.index) != '[') return false;
+    Json_Cursor element;
+    if (!json_cursor_first(c, &element)) return false;
+    for (; i > 0; --i) {
+        if (!json_cursor_next(&element)) return false;
+    }
+    *out = element;
+    return true;
+}
+
+// The string at the cursor as it is in the input, escapes included.
+bool json_cursor_raw_string(Json_Cursor c, Nob_String_View *out, bool *escaped) {
+    Token t = CursorToken(c);
+    if (t.kind != TK_STRING) return false;
+    *out = t.text;
+    if (escaped) *escaped = t.escaped;
+    return true;
+}
+
+// Appends the decoded string at the cursor to `out`.
+bool json_cursor_string(Json_Cursor c, Nob_String_Builder *out) {
+    Token t = CursorToken(c);
+    if (t.kind != TK_STRING) return false;
+    if (!t.escaped) {
+        nob_sb_append_buf(out, t.text.data, t.text.count);
+        return true;
+    }
+    return UnescapeString(t.text, out);
+}
+
+bool json_cursor_double(Json_Cursor c, double *out) {
+    Token t = CursorToken(c);
+    switch (t.kind) {
+        case TK_FLOAT: *out = t.num; return true;
+        case TK_INT: *out = (double)t.integer; return true;
+        case TK_UINT: *out = (double)t.uinteger; return true;
+        default: return false;
+    }
+}
+
+bool json_cursor_int64(Json_Cursor c, int64_t *out) {
+    Token t = CursorToken(c);
+    if (t.kind != TK_INT) return false;
+    *out = t.integer;
+    return true;
+}
+
+bool json_cursor_uint64(Json_Cursor c, uint64_t *out) {
+    Token t = CursorToken(c);
+    if (t.kind == TK_UINT) {
+        *out = t.uinteger;
+        return true;
+    }
+    if (t.kind == TK_INT && t.integer >= 0) {
+        *out = (uint64_t)t.integer;
+        return true;
+    }
+    return false;
+}
+
+bool json_cursor_bool(Json_Cursor c, bool *out) {
+    Token t = CursorToken(c);
+    if (t.kind != TK_TRUE && t.kind != TK_FALSE) return false;
+    *out = t.kind == TK_TRUE;
+    return true;
+}
+
+bool json_cursor_is_null(Json_Cursor c) {
+    return CursorToken(c).kind == TK_NULL;
+}
+
+// Builds a Json_Element tree for just the value at the cursor. Returns NULL
+// when the value is malformed.
+Json_Element *json_cursor_materialize(Json_Cursor c, Json_Arena *arena, Json_Parse_Options opts) {
+    Tokens tokens = {0};
+    size_t end = CursorSkip(c.doc, c.index);
+    for (size_t i = c.index; i < end; ++i) {
+        Token t = CursorToken((Json_Cursor){ c.doc, i });
+        if (t.kind == TK_NONE) {
+            nob_log(NOB_ERROR, "Unexpected character '%c' at byte %zu", CursorByte(c.doc, i), (size_t)c.doc->structurals.items[i]);
+            nob_da_free(tokens);
+            return NULL;
+        }
+        nob_da_append(&tokens, t);
+    }
+    Json_Element *e = ParseTokensEx(arena, tokens, opts);
+    nob_da_free(tokens);
+    return e;
+}
+
+// The JSON text of the value at the cursor, exactly as it is in the input.
+Nob_String_View json_cursor_raw(Json_Cursor c) {
+    const Json_Document *doc = c.doc;
+    if (c.index >= doc->structurals.count) return nob_sv_from_parts(NULL, 0);
+    size_t start = doc->structurals.items[c.index];
+    size_t end = start;
+    char first = CursorByte(doc, c.index);
+    if (first == '{' || first == '[') {
+        end = doc->structurals.items[CursorSkip(doc, c.index) - 1] + 1;
+    } else {
+        GetToken(doc->in, &end);
+    }
+    return nob_sv_from_parts(doc->in.data + start, end - start);
+}
+
+// Receives every value matching a path; return false to stop.
+typedef bool (*Json_Path_Callback)(Json_Cursor match, void *user);
+
+// Applies steps [step..] to the value at `c`. Members and elements that do
+// not match are skipped without being looked into.
+bool PathMatch(const Json_Path *path, size_t step, Json_Cursor c, Json_Path_Callback callback, void *user) {
+    if (step == path->count) return callback(c, user);
+
+    const Json_Path_Step *s = &path->items[step];
+    Json_Cursor child;
+    switch (CursorByte(c.doc, c.index)) {
+        case '{':
+            {
+                if (!s->wildcard) {
+                    if (!json_cursor_find(c, s->name, s->len, &child)) return true;
+                    return PathMatch(path, step + 1, child, callback, user);
+                }
+                if (!json_cursor_first(c, &child)) return true;
+                do {
+                    if (!PathMatch(path, step + 1, child, callback, user)) return false;
+                } while (json_cursor_next(&child));
+            } break;
+        case '[':
+            {
+                if (!s->wildcard) {
+                    if (!s->has_index || !json_cursor_at(c, s->index, &child)) return true;
+                    return PathMatch(path, step + 1, child, callback, user);
+                }
+                if (!json_cursor_first(c, &child)) return true;
+                do {
+                    if (!PathMatch(path, step + 1, child, callback, user)) return false;
+                } while (json_cursor_next(&child));
+            } break;
+        default: break;
+    }
+    return true;
+}
+
+// Runs the path against every top-level value of the document, so an NDJSON
+// buffer can be queried as a whole. Returns false when the callback stopped.
+bool json_path_run(const Json_Path *path, const Json_Document *doc, Json_Path_Callback callback, void *user) {
+    Json_Cursor c;
+    if (!json_document_root(doc, &c)) return true;
+    while (c.index < doc->structurals.count) {
+        if (!PathMatch(path, 0, c, callback, user)) return false;
+        c.index = CursorSkip(doc, c.index);
+    }
+    return true;
+}
+
+// One line of an NDJSON input after parsing. `root` lives in the arena of
+// the chunk that contained the line and is only valid during the callback.
+typedef struct {
+    // byte offset of the line in the input, increasing with input order
+    size_t offset;
+    Nob_String_View text;
+    // false when the line is not well-formed JSON; `root` is NULL then and
+    // `error` is the offset in the input of the first token that was rejected
+    bool ok;
+    size_t error;
+    Json_Element *root;
+} Json_Record;
+
+// Receives the parsed records; return false to stop. Calls are never
+// concurrent, so the callback does not need to be thread-safe.
+typedef bool (*Json_Record_Callback)(const Json_Record *record, void *user);
+
+typedef struct {
+    // worker threads if this call starts the context's pool, 0 for one per
+    // CPU; a running pool is reused as it is
+    size_t threads;
+    // bytes of input per work item, extended to the next newline; 0 for
+    // JSON_NDJSON_CHUNK_SIZE
+    size_t chunk_size;
+    // deliver records in input order; otherwise a chunk is delivered as soon
+    // as it is parsed
+    bool ordered;
+    // give every worker its own Json_Context so keys are interned per thread;
+    // `parse.ctx` is ignored since a context cannot be shared between threads
+    bool intern_keys;
+    Json_Parse_Options parse;
+} Json_Ndjson_Options;
+
+#define JSON_NDJSON_CHUNK_SIZE (1024*1024)
+
+typedef struct {
+    Json_Record *items;
+    size_t capacity;
+    size_t count;
+} Json_Records;
+
+typedef struct {
+    Json_Input in;
+    Json_Ndjson_Options opts;
+    Json_Record_Callback callback;
+    void *user;
+    const Json_Kernels *kernels;
+    // one per pool worker plus one for the submitting thread, indexed by
+    // json_pool_worker_index; only used with intern_keys
+    Json_Context *contexts;
+    Json_Pool *pool;
+
+#ifndef _WIN32
+    // serializes unordered deliveries, which come from the workers
+    pthread_mutex_t deliver_lock;
+#endif
+    atomic_bool stopped;
+    // some line was malformed
+    atomic_bool failed;
+} Ndjson_Job;
+
+// A run of whole lines parsed by one task. Every chunk keeps its arena and
+// token buffer across batches, so they only grow on the first few.
+typedef struct {
+    Ndjson_Job *job;
+    size_t start;
+    size_t end;
+    Json_Arena arena;
+    Tokens tokens;
+    Json_Records records;
+} Ndjson_Chunk;
+
+// Collects the tokens of one line and checks them against the grammar on the
+// way in, so a bad line stops at the token where it went wrong.
+typedef struct {
+    Tokens *tokens;
+    Json_Grammar grammar;
+} Ndjson_Line;
+
+bool NdjsonAppendToken(Token t, void *user) {
+    Ndjson_Line *line = user;
+    if (!GrammarStep(&line->grammar, t.kind, NULL)) return false;
+    nob_da_append(line->tokens, t);
+    return true;
+}
+
+void NdjsonDeliver(Ndjson_Job *job, Json_Records *records) {
+    for (size_t i = 0; i < records->count && !atomic_load(&job->stopped); ++i) {
+        if (!job->callback(&records->items[i], job->user)) atomic_store(&job->stopped, true);
+    }
+}
+
+// Pool task: parses every line of the chunk into the chunk's arena. Without
+// `ordered` the records are handed over right away.
+void NdjsonParseChunk(void *arg) {
+    Ndjson_Chunk *chunk = arg;
+    Ndjson_Job *job = chunk->job;
+    Json_Parse_Options parse = job->opts.parse;
+    if (job->opts.intern_keys) parse.ctx = &job->contexts[json_pool_worker_index(job->pool)];
+
+    arena_reset(&chunk->arena);
+    chunk->records.count = 0;
+    if (atomic_load(&job->stopped)) return;
+    for (size_t line = chunk->start; line < chunk->end;) {
+        const char *nl = memchr(job->in.data + line, '\n', chunk->end - line);
+        size_t line_end = nl ? (size_t)(nl - job->in.data) : chunk->end;
+        // the rest of the input follows every line, so the padding Tokenize
+        // needs is always there
+        Json_Input in = { .data = job->in.data + line, .count = line_end - line };
+        if (job->kernels->skip_whitespace(in.data, in.count, 0) < in.count) {
+            chunk->tokens.count = 0;
+            Ndjson_Line tokens = { .tokens = &chunk->tokens };
+            Json_Record record = {
+                .offset = line,
+                .text = nob_sv_from_parts(in.data, in.count),
+            };
+            if (TokenizeEach(in, NdjsonAppendToken, &tokens)) {
+                record.ok = GrammarEnd(&tokens.grammar);
+            } else {
+                nob_da_free(tokens.grammar.open);
+            }
+            if (record.ok) {
+                record.root = ParseTokensEx(&chunk->arena, chunk->tokens, parse);
+                record.ok = record.root != NULL;
+            }
+            if (!record.ok) {
+                // whatever was rejected starts right after the last token that
+                // was taken, or at the end of the line when it stopped early
+                size_t end = 0;
+                if (chunk->tokens.count > 0) {
+                    Token last = nob_da_last(&chunk->tokens);
+                    end = (size_t)(last.text.data + last.text.count - in.data) + (last.kind == TK_STRING ? 1 : 0);
+                }
+                record.error = line + job->kernels->skip_whitespace(in.data, in.count, end);
+                // the messages above count bytes from the start of the line
+                nob_log(NOB_ERROR, "NDJSON line at byte %zu is malformed at byte %zu", line, record.error);
+                atomic_store(&job->failed, true);
+            }
+            nob_da_append(&chunk->records, record);
+        }
+        line = line_end + 1;
+    }
+
+    if (!job->opts.ordered) {
+#ifndef _WIN32
+        pthread_mutex_lock(&job->deliver_lock);
+#endif
+        NdjsonDeliver(job, &chunk->records);
+#ifndef _WIN32
+        pthread_mutex_unlock(&job->deliver_lock);
+#endif
+    }
+}
+
+// Parses newline-delimited JSON on the task pool of `ctx` (a temporary one
+// when NULL): the input is cut into chunks at line boundaries and the chunks
+// are parsed in parallel, each into its own arena. Chunks go out in batches
+// of two per worker; the calling thread delivers one batch in order while the
+// workers parse the next. Malformed lines are still delivered, see
+// Json_Record. Returns false when a line was malformed or the callback
+// stopped early.
+bool ParseNdjson(Json_Context *ctx, Json_Input in, Json_Ndjson_Options opts, Json_Record_Callback callback, void *user) {
+    Json_Context local = {0};
+    if (ctx == NULL) ctx = &local;
+    Ndjson_Job job = {
+        .in = in, .opts = opts, .callback = callback, .user = user,
+        .kernels = json_kernels(),
+        .pool = json_context_pool(ctx, opts.threads),
+    };
+    atomic_init(&job.stopped, false);
+    atomic_init(&job.failed, false);
+    if (job.opts.chunk_size == 0) job.opts.chunk_size = JSON_NDJSON_CHUNK_SIZE;
+    if (job.opts.parse.ctx) {
+        nob_log(NOB_WARNING, "A Json_Context cannot be shared between threads, use intern_keys instead");
+        job.opts.parse.ctx = NULL;
+    }
+    if (job.opts.intern_keys) {
+        job.contexts = calloc(job.pool->count + 1, sizeof(Json_Context));
+        NOB_ASSERT(job.contexts != NULL && "Buy more RAM lol");
+    }
+#ifndef _WIN32
+    pthread_mutex_init(&job.deliver_lock, NULL);
+#endif
+
+    size_t batch = 2*(job.pool->count > 0 ? job.pool->count : 1);
+    Ndjson_Chunk *chunks = calloc(2*batch, sizeof(Ndjson_Chunk));
+    NOB_ASSERT(chunks != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < 2*batch; ++i) {
+        chunks[i].job = &job;
+        chunks[i].arena = arena_for_input(job.opts.chunk_size);
+    }
+
+    Json_Wait_Group group;
+    json_wait_group_init(&group);
+    Ndjson_Chunk *prev = NULL;
+    size_t prev_count = 0;
+    size_t offset = 0;
+    for (size_t round = 0;; ++round) {
+        Ndjson_Chunk *cur = &chunks[(round % 2)*batch];
+        size_t count = 0;
+        for (; count < batch && offset < in.count && !atomic_load(&job.stopped); ++count) {
+            Ndjson_Chunk *chunk = &cur[count];
+            chunk->start = offset;
+            chunk->end = offset + job.opts.chunk_size;
+            if (chunk->end >= in.count) {
+                chunk->end = in.count;
+            } else {
+                const char *nl = memchr(in.data + chunk->end, '\n', in.count - chunk->end);
+                chunk->end = nl ? (size_t)(nl - in.data) + 1 : in.count;
+            }
+            offset = chunk->end;
+            json_pool_submit(job.pool, &group, NdjsonParseChunk, chunk);
+        }
+        if (job.opts.ordered) {
+            for (size_t i = 0; i < prev_count; ++i) NdjsonDeliver(&job, &prev[i].records);
+        }
+        json_wait_group_wait(job.pool, &group);
+        if (count == 0) break;
+        prev = cur;
+        prev_count = count;
+    }
+    json_wait_group_destroy(&group);
+
+    for (size_t i = 0; i < 2*batch; ++i) {
+        arena_free(&chunks[i].arena);
+        nob_da_free(chunks[i].tokens);
+        nob_da_free(chunks[i].records);
+    }
+    free(chunks);
+    if (job.contexts) {
+        for (size_t i = 0; i <= job.pool->count; ++i) json_context_free(&job.contexts[i]);
+        free(job.contexts);
+    }
+#ifndef _WIN32
+    pthread_mutex_destroy(&job.deliver_lock);
+#endif
+    json_context_free(&local);
+    return !atomic_load(&job.stopped) && !atomic_load(&job.failed);
+}
+
+// Flat alternative to the Json_Element tree: the whole document is one array
+// of 64 bit words in document order, so walking it is a linear scan and
+// skipping a subtree or reading a container's size is a single lookup.
+//
+// Every entry has a tag character in the top byte and a 56 bit payload:
+//   '{' '['      index just past the matching close | element count << 32
+//   '}' ']'      index of the matching open
+//   '"'          offset into `strings`, which holds a uint32 length, the
+//                decoded bytes and a NUL terminator
+//   'l' 'u' 'd'  int64, uint64 or double; the value is in the next word
+//   't' 'f' 'n'  true, false and null, no payload
+// Object members are a key string followed by the value.
+typedef struct {
+    uint64_t *items;
+    size_t capacity;
+    size_t count;
+    Nob_String_Builder strings;
+} Json_Tape;
+
+#define JSON_TAPE_PAYLOAD_MASK ((1ULL << 56) - 1)
+#define JSON_TAPE_INDEX_MASK 0xFFFFFFFFULL
+// element counts saturate here, json_tape_len walks larger containers
+#define JSON_TAPE_MAX_COUNT 0xFFFFFFULL
+
+#define JSON_TAPE_TAG(word) ((char)((word) >> 56))
+#define JSON_TAPE_PAYLOAD(word) ((word) & JSON_TAPE_PAYLOAD_MASK)
+
+typedef struct {
+    // tape index of the open entry
+    size_t open;
+    size_t count;
+} Tape_Frame;
+
+typedef struct {
+    Tape_Frame *items;
+    size_t capacity;
+    size_t count;
+} Tape_Stack;
+
+typedef struct {
+    Json_Tape *tape;
+    Tape_Stack stack;
+} Tape_Builder;
+
+void TapeAppend(Json_Tape *tape, char tag, uint64_t payload) {
+    nob_da_append(tape, ((uint64_t)(unsigned char)tag << 56) | payload);
+}
+
+// Array elements are counted as values, object members by their keys.
+void TapeCountValue(Tape_Builder *b) {
+    if (b->stack.count > 0 && JSON_TAPE_TAG(b->tape->items[nob_da_last(&b->stack).open]) == '[') {
+        nob_da_last(&b->stack).count += 1;
+    }
+}
+
+bool TapeOpen(Tape_Builder *b, char tag) {
+    TapeCountValue(b);
+    if (b->tape->count > JSON_TAPE_INDEX_MASK) {
+        nob_log(NOB_ERROR, "Document is too big for the tape");
+        return false;
+    }
+    Tape_Frame frame = { .open = b->tape->count };
+    nob_da_append(&b->stack, frame);
+    TapeAppend(b->tape, tag, 0);
+    return true;
+}
+
+bool TapeClose(Tape_Builder *b, char tag) {
+    Tape_Frame frame = b->stack.items[--b->stack.count];
+    size_t count = frame.count < JSON_TAPE_MAX_COUNT ? frame.count : JSON_TAPE_MAX_COUNT;
+    TapeAppend(b->tape, tag, frame.open);
+    b->tape->items[frame.open] |= (uint64_t)b->tape->count | (uint64_t)count << 32;
+    return true;
+}
+
+bool TapeString(Tape_Builder *b, Nob_String_View text, bool escaped) {
+    Nob_String_Builder *strings = &b->tape->strings;
+    size_t offset = strings->count;
+    uint32_t len = (uint32_t)text.count;
+    if (text.count > UINT32_MAX) {
+        nob_log(NOB_ERROR, "String of %zu bytes is too long for the tape", text.count);
+        return false;
+    }
+
+    nob_da_reserve(strings, offset + sizeof(len) + text.count + 1);
+    char *out = strings->items + offset + sizeof(len);
+    size_t n = text.count;
+    if (!escaped) {
+        memcpy(out, text.data, n);
+    } else if (!UnescapeStringTo(text, out, &n)) {
+        nob_log(NOB_ERROR, "Invalid escape sequence in string \""SV_Fmt"\"", SV_Arg(text));
+        return false;
+    }
+    out[n] = '\0';
+    len = (uint32_t)n;
+    memcpy(strings->items + offset, &len, sizeof(len));
+    strings->count = offset + sizeof(len) + n + 1;
+
+    TapeAppend(b->tape, '"', offset);
+    return true;
+}
+
+bool TapeOnObjectBegin(void *user) { return TapeOpen(user, '{'); }
+bool TapeOnObjectEnd(void *user) { return TapeClose(user, '}'); }
+bool TapeOnArrayBegin(void *user) { return TapeOpen(user, '['); }
+bool TapeOnArrayEnd(void *user) { return TapeClose(user, ']'); }
+
+bool TapeOnKey(void *user, Nob_String_View key, bool escaped) {
+    Tape_Builder *b = user;
+    nob_da_last(&b->stack).count += 1;
+    return TapeString(b, key, escaped);
+}
+
+bool TapeOnString(void *user, Nob_String_View text, bool escaped) {
+    TapeCountValue(user);
+    return TapeString(user, text, escaped);
+}
+
+bool TapeOnNumber(void *user, Nob_String_View text, Json_Number number) {
+    (void)text;
+    Tape_Builder *b = user;
+    TapeCountValue(b);
+    uint64_t bits = 0;
+    switch (number.kind) {
+        case JSON_NUMBER_INT:
+            TapeAppend(b->tape, 'l', 0);
+            memcpy(&bits, &number.integer, sizeof(bits));
+            break;
+        case JSON_NUMBER_UINT:
+            TapeAppend(b->tape, 'u', 0);
+            bits = number.uinteger;
+            break;
+        case JSON_NUMBER_DOUBLE:
+            TapeAppend(b->tape, 'd', 0);
+            memcpy(&bits, &number.num, sizeof(bits));
+            break;
+    }
+    nob_da_append(b->tape, bits);
+    return true;
+}
+
+bool TapeOnBool(void *user, bool value) {
+    TapeCountValue(user);
+    TapeAppend(((Tape_Builder *)user)->tape, value ? 't' : 'f', 0);
+    return true;
+}
+
+bool TapeOnNull(void *user) {
+    TapeCountValue(user);
+    TapeAppend(((Tape_Builder *)user)->tape, 'n', 0);
+    return true;
+}
+
+// Parses the input straight onto the tape, without going through Tokens or
+// allocating per value. `tape` is cleared first, so it can be reused between
+// documents to keep its buffers. Returns false when the input is malformed,
+// including a bad token, and leaves the tape empty then: a half-built tape
+// has containers that were never closed.
+bool ParseTape(Json_Input in, Json_Tape *tape) {
+    static const Json_Sax_Handlers handlers = {
+        .on_object_begin = TapeOnObjectBegin,
+        .on_object_end = TapeOnObjectEnd,
+        .on_array_begin = TapeOnArrayBegin,
+        .on_array_end = TapeOnArrayEnd,
+        .on_key = TapeOnKey,
+        .on_string = TapeOnString,
+        .on_number = TapeOnNumber,
+        .on_bool = TapeOnBool,
+        .on_null = TapeOnNull,
+    };
+    tape->count = 0;
+    tape->strings.count = 0;
+    // roughly one entry per byte of structure, so start from a fraction of the input
+    nob_da_reserve(tape, in.count/8 + 16);
+
+    Tape_Builder b = { .tape = tape };
+    bool ok = SaxParse(in, &handlers, &b);
+    nob_da_free(b.stack);
+    if (!ok) {
+        tape->count = 0;
+        tape->strings.count = 0;
+    }
+    return ok;
+}
+
+void json_tape_free(Json_Tape *tape) {
+    nob_da_free(*tape);
+    nob_sb_free(tape->strings);
+    memset(tape, 0, sizeof(*tape));
+}
+
+Json_Kind json_tape_kind(const Json_Tape *tape, size_t i) {
+    switch (JSON_TAPE_TAG(tape->items[i])) {
+        case '{': return JK_OBJECT;
+        case '[': return JK_ARRAY;
+        case '"': return JK_STRING;
+        case 'l': return JK_INT;
+        case 'u': return JK_UINT;
+        case 'd': return JK_FLOAT;
+        case 't':
+        case 'f': return JK_BOOLEAN;
+        case 'n': return JK_NULL;
+        default: return JK_NONE;
+    }
+}
+
+// Index of the entry after the value at `i`, skipping the whole subtree of a
+// container.
+size_t json_tape_skip(const Json_Tape *tape, size_t i) {
+    uint64_t word = tape->items[i];
+    switch (JSON_TAPE_TAG(word)) {
+        case '{':
+        case '[': return (size_t)(word & JSON_TAPE_INDEX_MASK);
+        case 'l':
+        case 'u':
+        case 'd': return i + 2;
+        default: return i + 1;
+    }
+}
+
+// Number of members of an object or elements of an array.
+size_t json_tape_len(const Json_Tape *tape, size_t i) {
+    uint64_t word = tape->items[i];
+    size_t count = (size_t)(JSON_TAPE_PAYLOAD(word) >> 32);
+    if (count < JSON_TAPE_MAX_COUNT) return count;
+
+    bool object = JSON_TAPE_TAG(word) == '{';
+    size_t end = json_tape_skip(tape, i) - 1;
+    count = 0;
+    for (size_t j = i + 1; j < end; ++count) {
+        if (object) j += 1;
+        j = json_tape_skip(tape, j);
+    }
+    return count;
+}
+
+// The decoded text of a string or key entry.
+const char *json_tape_string(const Json_Tape *tape, size_t i, size_t *len) {
+    const char *s = tape->strings.items + JSON_TAPE_PAYLOAD(tape->items[i]);
+    uint32_t n;
+    memcpy(&n, s, sizeof(n));
+    if (len) *len = n;
+    return s + sizeof(n);
+}
+
+int64_t json_tape_int(const Json_Tape *tape, size_t i) {
+    int64_t value;
+    memcpy(&value, &tape->items[i + 1], sizeof(value));
+    return value;
+}
+
+uint64_t json_tape_uint(const Json_Tape *tape, size_t i) {
+    return tape->items[i + 1];
+}
+
+double json_tape_double(const Json_Tape *tape, size_t i) {
+    double value;
+    memcpy(&value, &tape->items[i + 1], sizeof(value));
+    return value;
+}
+
+bool json_tape_bool(const Json_Tape *tape, size_t i) {
+    return JSON_TAPE_TAG(tape->items[i]) == 't';
+}
+
+typedef enum {
+    JSON_NEWLINE_LF,
+    JSON_NEWLINE_CRLF,
+} Json_Newline;
+
+typedef struct {
+    // no whitespace at all; the other fields are ignored
+    bool minify;
+    // spaces (or tabs) per nesting level
+    size_t indent;
+    bool use_tabs;
+    Json_Newline newline;
+    // emit object members ordered by their decoded key bytes
+    bool sort_keys;
+} Json_Write_Options;
+
+#define JSON_WRITE_PRETTY ((Json_Write_Options){ .indent = SPACES_FOR_INDENT })
+#define JSON_WRITE_MINIFIED ((Json_Write_Options){ .minify = true })
+
+// Serializer state between tokens, so output can also be produced one token
+// at a time.
+typedef struct {
+    Json_Write_Options opts;
+    size_t depth;
+    // the last token opened a container; it stays on one line if it is empty
+    bool after_open;
+} Json_Writer;
+
+// Indentation is copied out of these buffers in slices instead of being built
+// per token, so pretty printing does not allocate.
+#define INDENT_SPACES "                                                                "
+#define INDENT_TABS   "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t"
+
+void AppendIndent(Nob_String_Builder *sb, size_t indent_amount, bool use_tabs) {
+    const char *fill = use_tabs ? INDENT_TABS : INDENT_SPACES;
+    const size_t chunk = use_tabs ? sizeof(INDENT_TABS) - 1 : sizeof(INDENT_SPACES) - 1;
+    while (indent_amount > chunk) {
+        nob_sb_append_buf(sb, fill, chunk);
+        indent_amount -= chunk;
+    }
+    nob_sb_append_buf(sb, fill, indent_amount);
+}
+
+void AppendNewline(Nob_String_Builder *sb, Json_Writer *w) {
+    if (w->opts.newline == JSON_NEWLINE_CRLF) {
+        nob_sb_append_buf(sb, "\r\n", 2);
+    } else {
+        nob_da_append(sb, '\n');
+    }
+    AppendIndent(sb, w->depth*w->opts.indent, w->opts.use_tabs);
+}
+
+// Strings, numbers and literals look the same in every output style.
+void AppendScalar(Nob_String_Builder *sb, Token t) {
+    switch (t.kind) {
+        case TK_STRING:
+            {
+                // the raw text is still escaped exactly as in the input, so it
+                // can be copied straight through without decoding
+                nob_da_reserve(sb, sb->count + t.text.count + 2);
+                sb->items[sb->count++] = '"';
+                memcpy(sb->items + sb->count, t.text.data, t.text.count);
+                sb->count += t.text.count;
+                sb->items[sb->count++] = '"';
+            } break;
+        case TK_FLOAT:
+            {
+                nob_da_reserve(sb, sb->count + JSON_NUMBER_MAX_CHARS);
+                sb->count += json_format_double(sb->items + sb->count, t.num);
+            } break;
+        case TK_INT:
+            {
+                nob_da_reserve(sb, sb->count + JSON_NUMBER_MAX_CHARS);
+                sb->count += json_format_int64(sb->items + sb->count, t.integer);
+            } break;
+        case TK_UINT:
+            {
+                nob_da_reserve(sb, sb->count + JSON_NUMBER_MAX_CHARS);
+                sb->count += json_format_uint64(sb->items + sb->count, t.uinteger);
+            } break;
+        case TK_NULL: nob_sb_append_buf(sb, "null", 4); break;
+        case TK_TRUE: nob_sb_append_buf(sb, "true", 4); break;
+        case TK_FALSE: nob_sb_append_buf(sb, "false", 5); break;
+        default: nob_log(NOB_ERROR, "Unknown token: %s", GetTokenKind(t.kind));
+    }
+}
+
+void WriteTokenMinified(Nob_String_Builder *sb, Token t) {
+    switch (t.kind) {
+        case TK_OPEN_CURLY_BRACE: nob_da_append(sb, '{'); break;
+        case TK_CLOSE_CURLY_BRACE: nob_da_append(sb, '}'); break;
+        case TK_OPEN_SQ_BRACKET: nob_da_append(sb, '['); break;
+        case TK_CLOSE_SQ_BRACKET: nob_da_append(sb, ']'); break;
+        case TK_COLON: nob_da_append(sb, ':'); break;
+        case TK_COMMA: nob_da_append(sb, ','); break;
+        default: AppendScalar(sb, t);
+    }
+}
+
+// Called before writing anything but a closing bracket: the first thing in a
+// container goes on its own line.
+void WriterBeginValue(Nob_String_Builder *sb, Json_Writer *w) {
+    if (w->after_open && !w->opts.minify) {
+        AppendNewline(sb, w);
+    }
+    w->after_open = false;
+}
+
+void WriteTokenPretty(Nob_String_Builder *sb, Json_Writer *w, Token t) {
+    bool is_close = t.kind == TK_CLOSE_CURLY_BRACE || t.kind == TK_CLOSE_SQ_BRACKET;
+    if (!is_close) {
+        WriterBeginValue(sb, w);
+    }
+    switch (t.kind) {
+        case TK_OPEN_CURLY_BRACE: 
+        case TK_OPEN_SQ_BRACKET: 
+            {
+                nob_da_append(sb, t.kind == TK_OPEN_CURLY_BRACE ? '{' : '[');
+                w->depth += 1;
+                w->after_open = true;
+                return;
+            } break;
+        case TK_CLOSE_CURLY_BRACE: 
+        case TK_CLOSE_SQ_BRACKET: 
+            {
+                if (w->depth > 0) w->depth -= 1;
+                // empty containers stay as {} and []
+                if (!w->after_open) AppendNewline(sb, w);
+                nob_da_append(sb, t.kind == TK_CLOSE_CURLY_BRACE ? '}' : ']');
+            } break;
+        case TK_COLON: nob_sb_append_buf(sb, ": ", 2); break;
+        case TK_COMMA: 
+            {
+                nob_da_append(sb, ',');
+                AppendNewline(sb, w);
+            } break;
+        default: AppendScalar(sb, t);
+    }
+    w->after_open = false;
+}
+
+void WriteToken(Nob_String_Builder *sb, Json_Writer *w, Token t) {
+    if (w->opts.minify) {
+        WriteTokenMinified(sb, t);
+    } else {
+        WriteTokenPretty(sb, w, t);
+    }
+}
+
+typedef struct {
+    // token index of the key, the value starts two tokens later
+    size_t key;
+    // the decoded key, which is what members are sorted by in every writer
+    const char *name;
+    size_t len;
+} Sort_Member;
+
+typedef struct {
+    Sort_Member *items;
+    size_t capacity;
+    size_t count;
+} Sort_Members;
+
+int CompareMembers(const void *a, const void *b) {
+    const Sort_Member *ma = a;
+    const Sort_Member *mb = b;
+    int c = memcmp(ma->name, mb->name, ma->len < mb->len ? ma->len : mb->len);
+    if (c != 0) return c;
+    return (ma->len > mb->len) - (ma->len < mb->len);
+}
+
+// Writes the value starting at token `i` with the members of every object
+// reordered by key, and returns the index of the first token after it.
+size_t WriteSortedValue(Nob_String_Builder *sb, Json_Writer *w, Tokens tokens, size_t i) {
+    Token t = tokens.items[i];
+    if (t.kind == TK_OPEN_SQ_BRACKET) {
+        WriteToken(sb, w, t);
+        i += 1;
+        while (i < tokens.count && tokens.items[i].kind != TK_CLOSE_SQ_BRACKET) {
+            if (tokens.items[i].kind == TK_COMMA) {
+                WriteToken(sb, w, tokens.items[i]);
+                i += 1;
+            } else {
+                i = WriteSortedValue(sb, w, tokens, i);
+            }
+        }
+        if (i < tokens.count) WriteToken(sb, w, tokens.items[i]);
+        return i + 1;
+    }
+    if (t.kind != TK_OPEN_CURLY_BRACE) {
+        WriteToken(sb, w, t);
+        return i + 1;
+    }
+
+    Sort_Members members = {0};
+    size_t escaped = 0;
+    size_t j = i + 1;
+    while (j + 2 < tokens.count && tokens.items[j].kind == TK_STRING && tokens.items[j + 1].kind == TK_COLON) {
+        Token key = tokens.items[j];
+        Sort_Member m = { .key = j, .name = key.text.data, .len = key.text.count };
+        if (key.escaped) escaped += key.text.count;
+        nob_da_append(&members, m);
+        j = SkipValue(tokens, j + 2);
+        if (j < tokens.count && tokens.items[j].kind == TK_COMMA) j += 1;
+    }
+    // decoding never makes a key longer, so `names` does not move once reserved
+    Nob_String_Builder names = {0};
+    if (escaped > 0) {
+        nob_da_reserve(&names, escaped);
+        for (size_t m = 0; m < members.count; ++m) {
+            Token key = tokens.items[members.items[m].key];
+            size_t n;
+            if (!key.escaped || !UnescapeStringTo(key.text, names.items + names.count, &n)) continue;
+            members.items[m].name = names.items + names.count;
+            members.items[m].len = n;
+            names.count += n;
+        }
+    }
+    if (members.count > 1) qsort(members.items, members.count, sizeof(*members.items), CompareMembers);
+
+    const Token colon = { .kind = TK_COLON };
+    const Token comma = { .kind = TK_COMMA };
+    WriteToken(sb, w, t);
+    for (size_t m = 0; m < members.count; ++m) {
+        if (m > 0) WriteToken(sb, w, comma);
+        WriteToken(sb, w, tokens.items[members.items[m].key]);
+        WriteToken(sb, w, colon);
+        WriteSortedValue(sb, w, tokens, members.items[m].key + 2);
+    }
+    nob_da_free(members);
+    nob_sb_free(names);
+
+    // j is on the closing brace unless the object was malformed
+    if (j < tokens.count && tokens.items[j].kind == TK_CLOSE_CURLY_BRACE) {
+        WriteToken(sb, w, tokens.items[j]);
+        return j + 1;
+    }
+    nob_log(NOB_ERROR, "Malformed object at token %zu, it is left unsorted", i);
+    return j;
+}
+
+Nob_String_Builder Tokens2Json(Tokens tokens, Json_Write_Options opts) {
+    Nob_String_Builder sb = {0};
+    Json_Writer w = { .opts = opts };
+
+    if (opts.sort_keys) {
+        size_t i = 0;
+        while (i < tokens.count) {
+            i = WriteSortedValue(&sb, &w, tokens, i);
+        }
+    } else if (opts.minify) {
+        for (size_t i = 0; i < tokens.count; ++i) {
+            WriteTokenMinified(&sb, tokens.items[i]);
+        }
+    } else {
+        for (size_t i = 0; i < tokens.count; ++i) {
+            WriteTokenPretty(&sb, &w, tokens.items[i]);
+        }
+    }
+
+    if (!opts.minify) {
+        w.depth = 0;
+        AppendNewline(&sb, &w);
+    }
+    return sb;
+}
+
+// Appends `text` as a quoted JSON string, escaping quotes, backslashes and
+// control characters. Runs without any of those are copied in one go.
+void AppendEscapedString(Nob_String_Builder *sb, const char *text, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    nob_da_reserve(sb, sb->count + len + 2);
+    sb->items[sb->count++] = '"';
+    size_t i = 0;
+    while (i < len) {
+        size_t run = i;
+        while (run < len && (unsigned char)text[run] >= 0x20 && text[run] != '"' && text[run] != '\\') run += 1;
+        nob_sb_append_buf(sb, text + i, run - i);
+        i = run;
+        if (i >= len) break;
+
+        char c = text[i++];
+        char escape[6] = { '\\', 0 };
+        size_t n = 2;
+        switch (c) {
+            case '"':  escape[1] = '"';  break;
+            case '\\': escape[1] = '\\'; break;
+            case '\b': escape[1] = 'b';  break;
+            case '\f': escape[1] = 'f';  break;
+            case '\n': escape[1] = 'n';  break;
+            case '\r': escape[1] = 'r';  break;
+            case '\t': escape[1] = 't';  break;
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = hex[(c >> 4) & 0xF];
+                escape[5] = hex[c & 0xF];
+                n = 6;
+        }
+        nob_sb_append_buf(sb, escape, n);
+    }
+    nob_da_append(sb, '"');
+}
+
+void AppendElementScalar(Nob_String_Builder *sb, const Json_Element *e) {
+    switch (e->kind) {
+        case JK_STRING: AppendEscapedString(sb, e->value.text, e->count); break;
+        case JK_FLOAT:
+            {
+                nob_da_reserve(sb, sb->count + JSON_NUMBER_MAX_CHARS);
+                sb->count += json_format_double(sb->items + sb->count, e->value.num);
+            } break;
+        case JK_INT:
+            {
+                nob_da_reserve(sb, sb->count + JSON_NUMBER_MAX_CHARS);
+                sb->count += json_format_int64(sb->items + sb->count, e->value.integer);
+            } break;
+        case JK_UINT:
+            {
+                nob_da_reserve(sb, sb->count + JSON_NUMBER_MAX_CHARS);
+                sb->count += json_format_uint64(sb->items + sb->count, e->value.uinteger);
+            } break;
+        case JK_BOOLEAN:
+            {
+                if (e->value.boolean) nob_sb_append_buf(sb, "true", 4);
+                else nob_sb_append_buf(sb, "false", 5);
+            } break;
+        case JK_NULL: nob_sb_append_buf(sb, "null", 4); break;
+        default: nob_log(NOB_ERROR, "Cannot serialize element of kind %s", GetJsonKind(e->kind));
+    }
+}
+
+typedef struct {
+    const Json_Element *e;
+    size_t depth;
+} Estimate_Item;
+
+typedef struct {
+    Estimate_Item *items;
+    size_t capacity;
+    size_t count;
+} Estimate_Stack;
+
+// Rough size of the serialized tree, used to reserve the output buffer once.
+// Escapes are not accounted for, so it can come out a little short.
+size_t EstimateJsonSize(const Json_Element *root, Json_Write_Options opts) {
+    size_t size = 0;
+    size_t indent = opts.minify ? 0 : opts.indent;
+    Estimate_Stack stack = {0};
+    Estimate_Item first = { root, 0 };
+    nob_da_append(&stack, first);
+    while (stack.count > 0) {
+        Estimate_Item item = stack.items[--stack.count];
+        for (const Json_Element *e = item.e; e; e = e->next) {
+            // separator, plus newline and indentation when pretty printing
+            size += 1;
+            if (!opts.minify) size += 2 + item.depth*indent;
+            if (e->key) size += e->key_len + 4;
+            switch (e->kind) {
+                case JK_OBJECT:
+                case JK_ARRAY:
+                    {
+                        size += 2;
+                        if (e->value.object) {
+                            Estimate_Item child = { e->value.object, item.depth + 1 };
+                            nob_da_append(&stack, child);
+                        }
+                    } break;
+                case JK_STRING: size += e->count + 2; break;
+                case JK_FLOAT: size += 24; break;
+                case JK_INT:
+                case JK_UINT: size += 20; break;
+                default: size += 5; break;
+            }
+            // only the root's siblings are not part of the document
+            if (e == root) break;
+        }
+    }
+    nob_da_free(stack);
+    return size;
+}
+
+typedef struct {
+    const Json_Element *container;
+    // next child to write when the members are written in document order
+    const Json_Element *next;
+    // the members ordered by key when sorting, NULL otherwise
+    const Json_Element **sorted;
+    size_t index;
+    size_t count;
+} Write_Frame;
+
+typedef struct {
+    Write_Frame *items;
+    size_t capacity;
+    size_t count;
+} Write_Stack;
+
+int CompareElementKeys(const void *a, const void *b) {
+    const Json_Element *ea = *(const Json_Element **)a;
+    const Json_Element *eb = *(const Json_Element **)b;
+    int c = memcmp(ea->key, eb->key, ea->key_len < eb->key_len ? ea->key_len : eb->key_len);
+    if (c != 0) return c;
+    return (ea->key_len > eb->key_len) - (ea->key_len < eb->key_len);
+}
+
+// Writes a scalar, or opens a container and pushes it so its children are
+// written by the loop in Element2Json.
+void WriteElementValue(Nob_String_Builder *sb, Json_Writer *w, Write_Stack *stack, const Json_Element *e) {
+    if (e->kind != JK_OBJECT && e->kind != JK_ARRAY) {
+        WriterBeginValue(sb, w);
+        AppendElementScalar(sb, e);
+        return;
+    }
+
+    Token open = { .kind = e->kind == JK_OBJECT ? TK_OPEN_CURLY_BRACE : TK_OPEN_SQ_BRACKET };
+    WriteToken(sb, w, open);
+    Write_Frame frame = { .container = e, .next = e->value.object };
+    if (e->kind == JK_OBJECT && w->opts.sort_keys) {
+        for (const Json_Element *c = e->value.object; c; c = c->next) frame.count += 1;
+        frame.sorted = malloc(frame.count*sizeof(*frame.sorted));
+        NOB_ASSERT((frame.count == 0 || frame.sorted != NULL) && "Buy more RAM lol");
+        size_t n = 0;
+        for (const Json_Element *c = e->value.object; c; c = c->next) frame.sorted[n++] = c;
+        if (frame.count > 1) qsort(frame.sorted, frame.count, sizeof(*frame.sorted), CompareElementKeys);
+    }
+    nob_da_append(stack, frame);
+}
+
+// Serializes a parsed tree. The walk keeps its own stack of open containers,
+// so nesting depth is not limited by the C stack.
+Nob_String_Builder Element2Json(const Json_Element *root, Json_Write_Options opts) {
+    Nob_String_Builder sb = {0};
+    Json_Writer w = { .opts = opts };
+    Write_Stack stack = {0};
+
+    nob_da_reserve(&sb, EstimateJsonSize(root, opts));
+
+    WriteElementValue(&sb, &w, &stack, root);
+    while (stack.count > 0) {
+        Write_Frame *top = &nob_da_last(&stack);
+        const Json_Element *child = NULL;
+        if (top->sorted) {
+            if (top->index < top->count) child = top->sorted[top->index];
+        } else {
+            child = top->next;
+            if (child) top->next = child->next;
+        }
+
+        if (!child) {
+            Token close = { .kind = top->container->kind == JK_OBJECT ? TK_CLOSE_CURLY_BRACE : TK_CLOSE_SQ_BRACKET };
+            WriteToken(&sb, &w, close);
+            free(top->sorted);
+            stack.count -= 1;
+            continue;
+        }
+
+        if (top->index > 0) {
+            Token comma = { .kind = TK_COMMA };
+            WriteToken(&sb, &w, comma);
+        }
+        top->index += 1;
+        if (top->container->kind == JK_OBJECT) {
+            Token colon = { .kind = TK_COLON };
+            WriterBeginValue(&sb, &w);
+            AppendEscapedString(&sb, child->key, child->key_len);
+            WriteToken(&sb, &w, colon);
+        }
+        // may push, so `top` is not valid after this
+        WriteElementValue(&sb, &w, &stack, child);
+    }
+
+    if (!opts.minify) {
+        w.depth = 0;
+        AppendNewline(&sb, &w);
+    }
+    nob_da_free(stack);
+    return sb;
+}
+
+typedef struct {
+    // tape index of the open entry
+    size_t open;
+    // next entry to write when the members are written in document order
+    size_t next;
+    // tape indices of the keys ordered by key when sorting, NULL otherwise
+    size_t *sorted;
+    size_t index;
+    size_t count;
+} Tape_Write_Frame;
+
+typedef struct {
+    Tape_Write_Frame *items;
+    size_t capacity;
+    size_t count;
+} Tape_Write_Stack;
+
+_Thread_local const Json_Tape *sort_tape;
+
+int CompareTapeKeys(const void *a, const void *b) {
+    size_t la, lb;
+    const char *ka = json_tape_string(sort_tape, *(const size_t *)a, &la);
+    const char *kb = json_tape_string(sort_tape, *(const size_t *)b, &lb);
+    int c = memcmp(ka, kb, la < lb ? la : lb);
+    if (c != 0) return c;
+    return (la > lb) - (la < lb);
+}
+
+// Writes the value at tape index `i`, pushing containers so their children are
+// written by the loop in Tape2Json.
+void WriteTapeValue(Nob_String_Builder *sb, Json_Writer *w, Tape_Write_Stack *stack, const Json_Tape *tape, size_t i) {
+    char tag = JSON_TAPE_TAG(tape->items[i]);
+    if (tag == '{' || tag == '[') {
+        Token open = { .kind = tag == '{' ? TK_OPEN_CURLY_BRACE : TK_OPEN_SQ_BRACKET };
+        WriteToken(sb, w, open);
+        Tape_Write_Frame frame = { .open = i, .next = i + 1 };
+        if (tag == '{' && w->opts.sort_keys) {
+            frame.count = json_tape_len(tape, i);
+            frame.sorted = malloc(frame.count*sizeof(*frame.sorted));
+            NOB_ASSERT((frame.count == 0 || frame.sorted != NULL) && "Buy more RAM lol");
+            size_t key = i + 1;
+            for (size_t n = 0; n < frame.count; ++n) {
+                frame.sorted[n] = key;
+                key = json_tape_skip(tape, key + 1);
+            }
+            if (frame.count > 1) {
+                const Json_Tape *saved = sort_tape;
+                sort_tape = tape;
+                qsort(frame.sorted, frame.count, sizeof(*frame.sorted), CompareTapeKeys);
+                sort_tape = saved;
+            }
+        }
+        nob_da_append(stack, frame);
+        return;
+    }
+
+    WriterBeginValue(sb, w);
+    switch (tag) {
+        case '"':
+            {
+                size_t len;
+                const char *text = json_tape_string(tape, i, &len);
+                AppendEscapedString(sb, text, len);
+            } break;
+        case 'l':
+            {
+                nob_da_reserve(sb, sb->count + JSON_NUMBER_MAX_CHARS);
+                sb->count += json_format_int64(sb->items + sb->count, json_tape_int(tape, i));
+            } break;
+        case 'u':
+            {
+                nob_da_reserve(sb, sb->count + JSON_NUMBER_MAX_CHARS);
+                sb->count += json_format_uint64(sb->items + sb->count, json_tape_uint(tape, i));
+            } break;
+        case 'd':
+            {
+                nob_da_reserve(sb, sb->count + JSON_NUMBER_MAX_CHARS);
+                sb->count += json_format_double(sb->items + sb->count, json_tape_double(tape, i));
+            } break;
+        case 't': nob_sb_append_buf(sb, "true", 4); break;
+        case 'f': nob_sb_append_buf(sb, "false", 5); break;
+        case 'n': nob_sb_append_buf(sb, "null", 4); break;
+        default: nob_log(NOB_ERROR, "Corrupt tape entry at %zu", i);
+    }
+}
+
+// Serializes the first value on the tape, the same way Element2Json does.
+Nob_String_Builder Tape2Json(const Json_Tape *tape, Json_Write_Options opts) {
+    Nob_String_Builder sb = {0};
+    Json_Writer w = { .opts = opts };
+    Tape_Write_Stack stack = {0};
+
+    // the input was at least as long as the structure and strings on the tape
+    nob_da_reserve(&sb, tape->count*4 + tape->strings.count);
+
+    if (tape->count > 0) WriteTapeValue(&sb, &w, &stack, tape, 0);
+    while (stack.count > 0) {
+        Tape_Write_Frame *top = &nob_da_last(&stack);
+        bool object = JSON_TAPE_TAG(tape->items[top->open]) == '{';
+        size_t end = json_tape_skip(tape, top->open) - 1;
+        size_t child = end;
+        if (top->sorted) {
+            if (top->index < top->count) child = top->sorted[top->index];
+        } else if (top->next < end) {
+            child = top->next;
+            top->next = json_tape_skip(tape, object ? child + 1 : child);
+        }
+
+        if (child == end) {
+            Token close = { .kind = object ? TK_CLOSE_CURLY_BRACE : TK_CLOSE_SQ_BRACKET };
+            WriteToken(&sb, &w, close);
+            free(top->sorted);
+            stack.count -= 1;
+            continue;
+        }
+
+        if (top->index > 0) {
+            Token comma = { .kind = TK_COMMA };
+            WriteToken(&sb, &w, comma);
+        }
+        top->index += 1;
+        if (object) {
+            Token colon = { .kind = TK_COLON };
+            size_t len;
+            const char *key = json_tape_string(tape, child, &len);
+            WriterBeginValue(&sb, &w);
+            AppendEscapedString(&sb, key, len);
+            WriteToken(&sb, &w, colon);
+            child += 1;
+        }
+        // may push, so `top` is not valid after this
+        WriteTapeValue(&sb, &w, &stack, tape, child);
+    }
+
+    if (!opts.minify) {
+        w.depth = 0;
+        AppendNewline(&sb, &w);
+    }
+    nob_da_free(stack);
+    return sb;
+}
+
+// Ready-made tasks for the pool of a Json_Context, so documents can be
+// parsed, written and queried side by side: submit one with the matching
+// function through json_pool_submit and read the results once its wait group
+// is done. Every task only touches its own struct; `parse.ctx` of parse tasks
+// running at the same time must not be the same context.
+typedef struct {
+    Json_Input in;
+    Json_Parse_Options parse;
+    // results: the tree is in `arena`, which the caller frees; `root` is NULL
+    // when the input is malformed
+    Json_Arena arena;
+    Json_Element *root;
+} Json_Parse_Task;
+
+void json_parse_task(void *arg) {
+    Json_Parse_Task *task = arg;
+    Tokens tokens = {0};
+    task->arena = arena_for_input(task->in.count);
+    task->root = Tokenize(task->in, &tokens) ? ParseTokensEx(&task->arena, tokens, task->parse) : NULL;
+    nob_da_free(tokens);
+}
+
+typedef struct {
+    const Json_Element *root;
+    Json_Write_Options opts;
+    // result, freed by the caller
+    Nob_String_Builder out;
+} Json_Write_Task;
+
+void json_write_task(void *arg) {
+    Json_Write_Task *task = arg;
+    task->out = Element2Json(task->root, task->opts);
+}
+
+// `callback` is called from the worker running the task.
+typedef struct {
+    const Json_Path *path;
+    const Json_Document *doc;
+    Json_Path_Callback callback;
+    void *user;
+    // result of json_path_run
+    bool ok;
+} Json_Query_Task;
+
+void json_query_task(void *arg) {
+    Json_Query_Task *task = arg;
+    task->ok = json_path_run(task->path, task->doc, task->callback, task->user);
+}
+
+// Output side of --query: every match on its own line, as it is in the input.
+bool QueryWriteMatch(Json_Cursor match, void *user) {
+    Nob_String_View raw = json_cursor_raw(match);
+    nob_sb_append_buf((Nob_String_Builder *)user, raw.data, raw.count);
+    nob_da_append((Nob_String_Builder *)user, '\n');
+    return true;
+}
+
+// Output side of --ndjson: every record written with the output options.
+typedef struct {
+    Json_Write_Options opts;
+    Nob_String_Builder out;
+} Ndjson_Writer;
+
+bool NdjsonWriteRecord(const Json_Record *record, void *user) {
+    Ndjson_Writer *nw = user;
+    // the parser already logged why
+    if (!record->ok) return true;
+    Nob_String_Builder sb = Element2Json(record->root, nw->opts);
+    nob_sb_append_buf(&nw->out, sb.items, sb.count);
+    if (nw->opts.minify) nob_da_append(&nw->out, '\n');
+    nob_sb_free(sb);
+    return true;
+}
+
+// Output side of --stream: tokens are written as they arrive and flushed to
+// the file whenever a chunk's worth of output has built up.
+typedef struct {
+    Json_Writer w;
+    Nob_String_Builder out;
+    FILE *fp;
+    // the tokens are not parsed, so they are checked on the way through
+    Json_Grammar grammar;
+} Stream_Writer;
+
+bool StreamWriteToken(Token t, void *user) {
+    Stream_Writer *sw = user;
+    if (!GrammarStep(&sw->grammar, t.kind, NULL)) return false;
+    WriteToken(&sw->out, &sw->w, t);
+    if (sw->out.count >= JSON_STREAM_CHUNK_SIZE) {
+        fwrite(sw->out.items, 1, sw->out.count, sw->fp);
+        sw->out.count = 0;
+    }
+    return true;
+}
+
+// Output side of --token-ring: tokens are written as they come off the ring,
+// so the document's tokens are never all held at once.
+bool RingWriteToken(Token t, void *user) {
+    Stream_Writer *sw = user;
+    if (!GrammarStep(&sw->grammar, t.kind, NULL)) return false;
+    WriteToken(&sw->out, &sw->w, t);
+    return true;
+}
+
+// Chunks in flight between two stages of --pipeline.
+#define JSON_PIPELINE_DEPTH 8
+
+// Output side of --pipeline: the same work as --stream, split over three
+// threads so reading, formatting and writing overlap. A reader thread fills
+// input chunks, the calling thread tokenizes them and writes the tokens into
+// output chunks, and a writer thread flushes those to the file. Every pair of
+// stages is connected by a Json_Ring for full chunks and one that returns the
+// empty ones, so memory stays at JSON_PIPELINE_DEPTH chunks a side.
+typedef struct {
+    FILE *in;
+    const char *path;
+    FILE *out;
+    size_t chunk_size;
+
+    Json_Ring in_full;
+    Json_Ring in_free;
+    Json_Ring out_full;
+    Json_Ring out_free;
+
+    Json_Writer w;
+    Json_Grammar grammar;
+    // the chunk the formatter writes into
+    Nob_String_Builder *out_chunk;
+    // set by the reader and writer, read after joining them
+    bool read_failed;
+    bool write_failed;
+} Pipeline;
+
+#ifndef _WIN32
+void *PipelineRead(void *arg) {
+    Pipeline *p = arg;
+    void *item;
+    while (json_ring_pop(&p->in_free, &item)) {
+        Nob_String_Builder *chunk = item;
+        chunk->count = fread(chunk->items, 1, p->chunk_size, p->in);
+        if (chunk->count > 0 && !json_ring_push(&p->in_full, chunk)) break;
+        if (chunk->count < p->chunk_size) {
+            if (ferror(p->in)) {
+                nob_log(NOB_ERROR, "Could not read file %s: %s", p->path, strerror(errno));
+                p->read_failed = true;
+            }
+            break;
+        }
+    }
+    json_ring_close(&p->in_full);
+    return NULL;
+}
+
+void *PipelineWrite(void *arg) {
+    Pipeline *p = arg;
+    void *item;
+    while (json_ring_pop(&p->out_full, &item)) {
+        Nob_String_Builder *chunk = item;
+        if (!p->write_failed && fwrite(chunk->items, 1, chunk->count, p->out) < chunk->count) {
+            nob_log(NOB_ERROR, "Could not write output: %s", strerror(errno));
+            p->write_failed = true;
+        }
+        chunk->count = 0;
+        // there is a slot for every chunk, so this never waits
+        json_ring_push(&p->out_free, chunk);
+    }
+    return NULL;
+}
+
+// Hands the current output chunk to the writer and takes an empty one.
+bool PipelineFlush(Pipeline *p) {
+    void *item;
+    if (!json_ring_push(&p->out_full, p->out_chunk)) return false;
+    if (!json_ring_pop(&p->out_free, &item)) return false;
+    p->out_chunk = item;
+    return true;
+}
+
+bool PipelineWriteToken(Token t, void *user) {
+    Pipeline *p = user;
+    if (!GrammarStep(&p->grammar, t.kind, NULL)) return false;
+    WriteToken(p->out_chunk, &p->w, t);
+    if (p->out_chunk->count >= p->chunk_size) return PipelineFlush(p);
+    return true;
+}
+#endif // _WIN32
+
+bool ReformatPipelined(const char *path, FILE *out, Json_Write_Options opts) {
+#ifndef _WIN32
+    Pipeline p = { .path = path, .out = out, .chunk_size = JSON_STREAM_CHUNK_SIZE, .w = { .opts = opts } };
+    p.in = fopen(path, "rb");
+    if (p.in == NULL) {
+        nob_log(NOB_ERROR, "Could not open file %s: %s", path, strerror(errno));
+        return false;
+    }
+    Nob_String_Builder chunks[2*JSON_PIPELINE_DEPTH] = {0};
+    json_ring_init(&p.in_full, JSON_PIPELINE_DEPTH);
+    json_ring_init(&p.in_free, JSON_PIPELINE_DEPTH);
+    json_ring_init(&p.out_full, JSON_PIPELINE_DEPTH);
+    json_ring_init(&p.out_free, JSON_PIPELINE_DEPTH);
+    for (size_t i = 0; i < JSON_PIPELINE_DEPTH; ++i) {
+        nob_da_reserve(&chunks[i], p.chunk_size);
+        json_ring_push(&p.in_free, &chunks[i]);
+    }
+    // one output chunk is always with the formatter
+    p.out_chunk = &chunks[JSON_PIPELINE_DEPTH];
+    for (size_t i = JSON_PIPELINE_DEPTH + 1; i < 2*JSON_PIPELINE_DEPTH; ++i) json_ring_push(&p.out_free, &chunks[i]);
+
+    pthread_t reader, writer;
+    bool ok = true;
+    // pthread_create returns the error instead of setting errno
+    int rc = pthread_create(&reader, NULL, PipelineRead, &p);
+    if (rc != 0) {
+        nob_log(NOB_ERROR, "Could not start reader thread: %s", strerror(rc));
+        ok = false;
+    } else if ((rc = pthread_create(&writer, NULL, PipelineWrite, &p)) != 0) {
+        nob_log(NOB_ERROR, "Could not start writer thread: %s", strerror(rc));
+        json_ring_close(&p.in_free);
+        json_ring_close(&p.in_full);
+        pthread_join(reader, NULL);
+        ok = false;
+    }
+
+    if (ok) {
+        Json_Stream s = {0};
+        void *item;
+        while (ok && json_ring_pop(&p.in_full, &item)) {
+            Nob_String_Builder *chunk = item;
+            // the stream copies what it keeps, so the chunk can go right back
+            ok = json_stream_feed(&s, chunk->items, chunk->count, PipelineWriteToken, &p);
+            json_ring_push(&p.in_free, chunk);
+        }
+        // stops the reader if the formatter gave up early
+        json_ring_close(&p.in_free);
+        json_ring_close(&p.in_full);
+        pthread_join(reader, NULL);
+        ok = ok && !p.read_failed && json_stream_finish(&s, PipelineWriteToken, &p);
+        ok = ok && GrammarEnd(&p.grammar);
+        json_stream_free(&s);
+        nob_da_free(p.grammar.open);
+
+        if (!opts.minify) {
+            p.w.depth = 0;
+            AppendNewline(p.out_chunk, &p.w);
+        }
+        if (p.out_chunk->count > 0) json_ring_push(&p.out_full, p.out_chunk);
+        json_ring_close(&p.out_full);
+        pthread_join(writer, NULL);
+        ok = ok && !p.write_failed;
+    }
+
+    for (size_t i = 0; i < 2*JSON_PIPELINE_DEPTH; ++i) nob_sb_free(chunks[i]);
+    json_ring_free(&p.in_full);
+    json_ring_free(&p.in_free);
+    json_ring_free(&p.out_full);
+    json_ring_free(&p.out_free);
+    fclose(p.in);
+    return ok;
+#else
+    // no threads to pipeline on, same work in one
+    Stream_Writer sw = { .w = { .opts = opts }, .fp = out };
+    bool ok = TokenizeStream(path, JSON_STREAM_CHUNK_SIZE, StreamWriteToken, &sw);
+    ok = ok && GrammarEnd(&sw.grammar);
+    nob_da_free(sw.grammar.open);
+    if (!opts.minify) {
+        sw.w.depth = 0;
+        AppendNewline(&sw.out, &sw.w);
+    }
+    fwrite(sw.out.items, 1, sw.out.count, out);
+    nob_sb_free(sw.out);
+    return ok;
+#endif
+}
+
+int main(int argc, char **argv) {
+
+    //const char *filePath = "./data/nasa.json";
+    const char *filePath = "./data/weather.json";
+    Json_Write_Options opts = JSON_WRITE_PRETTY;
+    // parse into a Json_Element tree and write that instead of the tokens
+    bool from_tree = false;
+    // tokenize and write in fixed-size chunks, for files larger than memory
+    bool stream = false;
+    // like --stream, with reading and writing on their own threads
+    bool pipeline = false;
+    // tokenize on a second thread and write the tokens as they arrive
+    bool token_ring = false;
+    // parse onto a Json_Tape and write that instead of the tokens
+    bool from_tape = false;
+    // JSON Pointer (with * wildcards) to extract instead of reformatting
+    const char *query = NULL;
+    // with --tree, only keep these paths in the tree (--keep can be repeated)
+    Json_Projection projection = {0};
+    // parse newline-delimited records on several threads
+    bool ndjson = false;
+    Json_Ndjson_Options ndjson_opts = { .ordered = true };
+    // tokenize the document on several threads
+    bool parallel = false;
+    // log the task pool counters after --ndjson or --parallel
+    bool pool_stats = false;
+
+    nob_shift(argv, argc);
+    while (argc > 0) {
+        const char *arg = nob_shift(argv, argc);
+        if (strcmp(arg, "--minify") == 0) {
+            opts.minify = true;
+        } else if (strcmp(arg, "--indent") == 0 && argc > 0) {
+            opts.indent = (size_t)atoi(nob_shift(argv, argc));
+        } else if (strcmp(arg, "--tabs") == 0) {
+            opts.use_tabs = true;
+            opts.indent = 1;
+        } else if (strcmp(arg, "--crlf") == 0) {
+            opts.newline = JSON_NEWLINE_CRLF;
+        } else if (strcmp(arg, "--sort-keys") == 0) {
+            opts.sort_keys = true;
+        } else if (strcmp(arg, "--tree") == 0) {
+            from_tree = true;
+        } else if (strcmp(arg, "--stream") == 0) {
+            stream = true;
+        } else if (strcmp(arg, "--pipeline") == 0) {
+            pipeline = true;
+        } else if (strcmp(arg, "--token-ring") == 0) {
+            token_ring = true;
+        } else if (strcmp(arg, "--tape") == 0) {
+            from_tape = true;
+        } else if (strcmp(arg, "--query") == 0 && argc > 0) {
+            query = nob_shift(argv, argc);
+        } else if (strcmp(arg, "--ndjson") == 0) {
+            ndjson = true;
+        } else if (strcmp(arg, "--threads") == 0 && argc > 0) {
+            ndjson_opts.threads = (size_t)atoi(nob_shift(argv, argc));
+        } else if (strcmp(arg, "--unordered") == 0) {
+            ndjson_opts.ordered = false;
+        } else if (strcmp(arg, "--parallel") == 0) {
+            parallel = true;
+        } else if (strcmp(arg, "--stats") == 0) {
+            pool_stats = true;
+        } else if (strcmp(arg, "--keep") == 0 && argc > 0) {
+            if (!json_projection_add(&projection, nob_shift(argv, argc))) {
+                json_projection_free(&projection);
+                return 1;
+            }
+            from_tree = true;
+        } else {
+            filePath = arg;
+        }
+    }
+
+    if (stream || pipeline) {
+        if (opts.sort_keys || from_tree || from_tape) {
+            nob_log(NOB_WARNING, "--sort-keys, --tree and --tape need the whole document, ignoring them with --stream and --pipeline");
+        }
+        json_projection_free(&projection);
+        FILE *fp = fopen("./dump.json", "w");
+        if (fp == NULL) {
+            nob_log(NOB_ERROR, "Could not open ./dump.json: %s", strerror(errno));
+            return 1;
+        }
+        bool ok;
+        if (pipeline) {
+            ok = ReformatPipelined(filePath, fp, opts);
+        } else {
+            Stream_Writer sw = { .w = { .opts = opts }, .fp = fp };
+            ok = TokenizeStream(filePath, JSON_STREAM_CHUNK_SIZE, StreamWriteToken, &sw);
+            ok = ok && GrammarEnd(&sw.grammar);
+            nob_da_free(sw.grammar.open);
+            if (!opts.minify) {
+                sw.w.depth = 0;
+                AppendNewline(&sw.out, &sw.w);
+            }
+            if (sw.out.count > 0) fwrite(sw.out.items, 1, sw.out.count, fp);
+            nob_sb_free(sw.out);
+        }
+        fclose(fp);
+        return ok ? 0 : 1;
+    }
+
+    Json_Input in = {0};
+    if (!json_input_map_file(filePath, &in)) {
+        json_projection_free(&projection);
+        return 1;
+    }
+
+    Tokens tokens = {0};
+    Nob_String_Builder result = {0};
+    // owns the worker threads of --ndjson and --parallel
+    Json_Context ctx = {0};
+    bool ok = true;
+    if (ndjson) {
+        Ndjson_Writer nw = { .opts = opts };
+        ndjson_opts.parse.projection = projection.count > 0 ? &projection : NULL;
+        ok = ParseNdjson(&ctx, in, ndjson_opts, NdjsonWriteRecord, &nw);
+        json_projection_free(&projection);
+        result = nw.out;
+    } else if (query) {
+        Json_Path path;
+        Json_Document doc;
+        ok = json_path_compile(query, &path);
+        if (ok) {
+            ok = json_document_init(&doc, in) && json_path_run(&path, &doc, QueryWriteMatch, &result);
+            json_document_free(&doc);
+            json_path_free(&path);
+        }
+    } else if (from_tape) {
+        // the tape is built straight from the input, no Tokens needed
+        Json_Tape tape = {0};
+        ok = ParseTape(in, &tape);
+        if (ok) result = Tape2Json(&tape, opts);
+        json_tape_free(&tape);
+    } else if (from_tree) {
+        ok = parallel ? TokenizeParallel(json_context_pool(&ctx, ndjson_opts.threads), in, &tokens) : Tokenize(in, &tokens);
+        Json_Arena arena = arena_for_input(in.count);
+        Json_Parse_Options parse = { .projection = projection.count > 0 ? &projection : NULL };
+        Json_Element *root = ok ? ParseTokensEx(&arena, tokens, parse) : NULL;
+        if (root) result = Element2Json(root, opts);
+        else ok = false;
+        arena_free(&arena);
+        json_projection_free(&projection);
+    } else if (token_ring) {
+        Stream_Writer sw = { .w = { .opts = opts } };
+        ok = TokenizeEachThreaded(in, JSON_TOKEN_RING_CAPACITY, RingWriteToken, &sw);
+        ok = ok && GrammarEnd(&sw.grammar);
+        nob_da_free(sw.grammar.open);
+        if (!opts.minify) {
+            sw.w.depth = 0;
+            AppendNewline(&sw.out, &sw.w);
+        }
+        if (ok) result = sw.out;
+        else nob_sb_free(sw.out);
+    } else {
+        ok = parallel ? TokenizeParallel(json_context_pool(&ctx, ndjson_opts.threads), in, &tokens) : Tokenize(in, &tokens);
+        // the tokens are written as they are, so check the grammar first
+        ok = ok && CheckTokens(tokens);
+        if (ok) result = Tokens2Json(tokens, opts);
+    }
+
+    if (pool_stats && ctx.pool_started) {
+        Json_Pool_Stats stats = json_pool_stats(&ctx.pool);
+        nob_log(NOB_INFO, "pool: %zu threads, %zu tasks submitted, %zu executed by workers, %zu stolen, %zu queued",
+                stats.threads, stats.submitted, stats.executed, stats.stolen, stats.queued);
+    }
+    json_context_free(&ctx);
+    json_projection_free(&projection);
+
+    FILE *fp = fopen("./dump.json", "w");
+    if (fp == NULL) {
+        nob_log(NOB_ERROR, "Could not open ./dump.json: %s", strerror(errno));
+        nob_sb_free(result);
+        nob_da_free(tokens);
+        json_input_release(&in);
+        return 1;
+    }
+    if (result.count > 0) fwrite(result.items, 1, result.count, fp);
+    fclose(fp);
+    nob_sb_free(result);
+
+#if 0
+    FILE *fp = fopen("./info.txt", "w");
+    for (size_t i = 0; i < tokens.count; ++i) {
+        Token t = tokens.items[i];
+        if (t.kind != TK_STRING && t.kind != TK_FLOAT && t.kind != TK_INT)
+            fprintf(fp, "%s\n", GetTokenKind(t.kind));
+        if (t.kind == TK_STRING) {
+            fprintf(fp, SV_Fmt"\n", SV_Arg(t.text));
+        } if (t.kind == TK_FLOAT) {
+            fprintf(fp, "%f\n", t.num);
+        } if (t.kind == TK_INT) {
+            fprintf(fp, "%"PRId64"\n", t.integer);
+        }
+        //fprintf(fp, "--------------------------\n");
+    }
+
+    fclose(fp);
+#endif
+
+    // the tokens point into the input
+    nob_da_free(tokens);
+    json_input_release(&in);
+    return ok ? 0 : 1;
 }
@@ -3,6 +3,8 @@
 #define NOB_IMPLEMENTATION
 #define NOB_STRIP_PREFIX
 #include "../nob.h"
+#define JSON_NUMBER_IMPLEMENTATION
+#include "json_number.h"
 
 void add_comma(String_Builder *sb) {
     da_append(sb, ',');
@@ -45,7 +47,14 @@ void add_string(String_Builder *sb, const char *string) {
 }
 
 void add_float(String_Builder *sb, float value) {
-    sb_appendf(sb, "%f", value);
+    da_reserve(sb, sb->count + JSON_NUMBER_MAX_CHARS);
+    sb->count += json_format_float(sb->items + sb->count, value);
+    add_comma(sb);
+}
+
+void add_int(String_Builder *sb, int64_t value) {
+    da_reserve(sb, sb->count + JSON_NUMBER_MAX_CHARS);
+    sb->count += json_format_int64(sb->items + sb->count, value);
     add_comma(sb);
 }
 
@@ -73,7 +82,7 @@ int main() {
             add_string(&sb, "a");
             add_string(&sb, "b");
             add_string(&sb, "c");
-            add_float(&sb, 1234);
+            add_int(&sb, 1234);
             add_null(&sb);
             add_bool(&sb, true);
             add_bool(&sb, false);
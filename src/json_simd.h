@@ -0,0 +1,635 @@
+// Stage-1 structural scanner for the JSON tokenizer.
+//
+// The input is classified 64 bytes at a time into bitmasks (whitespace,
+// structural characters, quotes, backslashes). Bit tricks on those masks
+// resolve escapes and string regions without looking at individual bytes,
+// and the result is a flat index of every position where a token starts:
+// `{ } [ ] : ,`, opening quotes, and the first byte of every other scalar.
+//
+// The hot kernels (block classification, whitespace skipping, string-end
+// search and UTF-8 validation) exist in scalar, SSE2, AVX2 and AVX-512
+// flavours. The best one the CPU supports is picked once at startup through
+// cpuid; set `cjson_force_kernel=scalar|sse|avx2|avx512` in the environment to
+// pin a specific one, e.g. to compare them in benchmarks.
+//
+// Usage is the same as nob.h: include it anywhere for the declarations and
+// define JSON_SIMD_IMPLEMENTATION in exactly one translation unit.
+#ifndef JSON_SIMD_H_
+#define JSON_SIMD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The vector kernels are compiled with per-function target attributes, so the
+// rest of the program does not need -mavx2 and still runs on older CPUs.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define JSON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define JSON_BLOCK_SIZE 64
+
+typedef struct {
+    uint64_t whitespace;
+    uint64_t op;
+    uint64_t quote;
+    uint64_t backslash;
+} Json_Block_Masks;
+
+typedef enum {
+    JSON_KERNEL_SCALAR,
+    JSON_KERNEL_SSE,
+    JSON_KERNEL_AVX2,
+    JSON_KERNEL_AVX512,
+
+    JSON_KERNEL_COUNT
+} Json_Kernel;
+
+typedef struct {
+    Json_Kernel kind;
+    void (*classify_block)(const uint8_t *block, Json_Block_Masks *m);
+    // index of the first non-whitespace byte at or after `At`, or `len`
+    size_t (*skip_whitespace)(const char *data, size_t len, size_t At);
+    // index of the first '"' or '\\' at or after `At`, or `len`
+    size_t (*find_string_end)(const char *data, size_t len, size_t At);
+    bool (*validate_utf8)(const char *data, size_t len);
+} Json_Kernels;
+
+// State carried from one 64 byte block into the next.
+typedef struct {
+    // the first byte of the next block is escaped by a trailing backslash
+    uint64_t prev_escaped;
+    // all ones when the previous block ended inside a string
+    uint64_t prev_in_string;
+    // the previous block ended in the middle of a number or literal
+    uint64_t prev_scalar;
+} Json_Scanner_State;
+
+// Offsets of token starts into the input. Offsets are 32 bit, so the index is
+// only built for inputs below 4 GB; larger inputs go through the plain scanner.
+typedef struct {
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} Json_Structurals;
+
+// Structurals of one slice of a larger input, for scanning slices on several
+// threads. Whether a slice starts inside a string depends on every quote
+// before it, so the scan keeps both answers: starting inside a string simply
+// keeps the candidates a scan starting outside drops, and the other way round.
+// The real start state is the xor of `flips` over the slices before it.
+typedef struct {
+    // structurals if the slice starts outside a string
+    Json_Structurals outside;
+    // structurals if it starts inside one
+    Json_Structurals inside;
+    // odd number of unescaped quotes: the slice ends in the other state
+    bool flips;
+} Json_Slice_Structurals;
+
+// The kernels selected for this CPU. Detection runs on the first call.
+const Json_Kernels *json_kernels(void);
+const char *json_kernel_name(Json_Kernel kind);
+uint64_t json_block_structurals(const Json_Block_Masks *m, Json_Scanner_State *s);
+// Fills `out` (which is reset first) with the start of every token in `data`.
+// At least JSON_BLOCK_SIZE bytes after `len` must be readable; their contents
+// do not matter. Returns false when the input ends inside a string or is too
+// big to index.
+bool json_find_structurals(const char *data, size_t len, Json_Structurals *out);
+// Scans data[start, end) of a `len` byte input into `out` (reset first).
+// `start` must be a multiple of JSON_BLOCK_SIZE; the bytes before it are only
+// looked at to resume escapes and scalars. The same padding rules as
+// json_find_structurals apply. Returns false when the input is too big to
+// index or memory runs out.
+bool json_find_structurals_slice(const char *data, size_t len, size_t start, size_t end, Json_Slice_Structurals *out);
+void json_structurals_free(Json_Structurals *s);
+
+#endif // JSON_SIMD_H_
+
+#ifdef JSON_SIMD_IMPLEMENTATION
+
+void json__classify_block_scalar(const uint8_t *block, Json_Block_Masks *m) {
+    Json_Block_Masks r = {0};
+    for (size_t i = 0; i < JSON_BLOCK_SIZE; ++i) {
+        uint64_t bit = 1ULL << i;
+        switch (block[i]) {
+            case ' ': case '\t': case '\n': case '\r': r.whitespace |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': r.op |= bit; break;
+            case '"': r.quote |= bit; break;
+            case '\\': r.backslash |= bit; break;
+            default: break;
+        }
+    }
+    *m = r;
+}
+
+bool json__is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+size_t json__skip_whitespace_scalar(const char *data, size_t len, size_t At) {
+    while (At < len && json__is_whitespace(data[At])) At += 1;
+    return At;
+}
+
+size_t json__find_string_end_scalar(const char *data, size_t len, size_t At) {
+    while (At < len && data[At] != '"' && data[At] != '\\') At += 1;
+    return At;
+}
+
+// Length of the UTF-8 sequence starting at `s`, or 0 when it is malformed
+// (truncated, overlong, a surrogate or above U+10FFFF).
+size_t json__utf8_sequence(const uint8_t *s, size_t len) {
+    uint8_t c = s[0];
+    if (c < 0x80) return 1;
+    if (c < 0xC2) return 0;
+    if (c < 0xE0) {
+        if (len < 2 || (s[1] & 0xC0) != 0x80) return 0;
+        return 2;
+    }
+    if (c < 0xF0) {
+        if (len < 3 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80) return 0;
+        if (c == 0xE0 && s[1] < 0xA0) return 0;
+        if (c == 0xED && s[1] > 0x9F) return 0;
+        return 3;
+    }
+    if (c < 0xF5) {
+        if (len < 4 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80 || (s[3] & 0xC0) != 0x80) return 0;
+        if (c == 0xF0 && s[1] < 0x90) return 0;
+        if (c == 0xF4 && s[1] > 0x8F) return 0;
+        return 4;
+    }
+    return 0;
+}
+
+bool json__validate_utf8_scalar(const char *data, size_t len) {
+    const uint8_t *s = (const uint8_t *)data;
+    size_t i = 0;
+    while (i < len) {
+        // 8 ASCII bytes at a time
+        if (i + 8 <= len) {
+            uint64_t w;
+            memcpy(&w, s + i, sizeof(w));
+            if ((w & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        size_t n = json__utf8_sequence(s + i, len - i);
+        if (n == 0) return false;
+        i += n;
+    }
+    return true;
+}
+
+#ifdef JSON_SIMD_X86
+
+// SSE2 is part of x86-64, so this kernel is always available there
+__attribute__((target("sse2")))
+void json__classify_block_sse(const uint8_t *block, Json_Block_Masks *m) {
+    Json_Block_Masks r = {0};
+    for (size_t i = 0; i < JSON_BLOCK_SIZE; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + i));
+        // '[' and ']' are '{' and '}' with the 0x20 bit cleared
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        __m128i op = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+        __m128i quote = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+        __m128i backslash = _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+        r.whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << i;
+        r.op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << i;
+        r.quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(quote) << i;
+        r.backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(backslash) << i;
+    }
+    *m = r;
+}
+
+__attribute__((target("sse2")))
+size_t json__skip_whitespace_sse(const char *data, size_t len, size_t At) {
+    while (At + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + At));
+        __m128i ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        uint32_t other = ~(uint32_t)_mm_movemask_epi8(ws) & 0xFFFF;
+        if (other) return At + (size_t)__builtin_ctz(other);
+        At += 16;
+    }
+    return json__skip_whitespace_scalar(data, len, At);
+}
+
+__attribute__((target("sse2")))
+size_t json__find_string_end_sse(const char *data, size_t len, size_t At) {
+    while (At + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + At));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+        if (mask) return At + (size_t)__builtin_ctz(mask);
+        At += 16;
+    }
+    return json__find_string_end_scalar(data, len, At);
+}
+
+__attribute__((target("sse2")))
+bool json__validate_utf8_sse(const char *data, size_t len) {
+    const uint8_t *s = (const uint8_t *)data;
+    size_t i = 0;
+    while (i < len) {
+        if (i + 16 <= len) {
+            uint32_t high = (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i)));
+            if (high == 0) {
+                i += 16;
+                continue;
+            }
+            i += (size_t)__builtin_ctz(high);
+        }
+        size_t n = json__utf8_sequence(s + i, len - i);
+        if (n == 0) return false;
+        i += n;
+    }
+    return true;
+}
+
+__attribute__((target("avx2")))
+void json__classify_block_avx2(const uint8_t *block, Json_Block_Masks *m) {
+    Json_Block_Masks r = {0};
+    for (size_t i = 0; i < JSON_BLOCK_SIZE; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(block + i));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i ws = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        __m256i op = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+        __m256i quote = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'));
+        __m256i backslash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'));
+        r.whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << i;
+        r.op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << i;
+        r.quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(quote) << i;
+        r.backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(backslash) << i;
+    }
+    *m = r;
+}
+
+__attribute__((target("avx2")))
+size_t json__skip_whitespace_avx2(const char *data, size_t len, size_t At) {
+    while (At + 32 <= len) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + At));
+        __m256i ws = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        uint32_t other = ~(uint32_t)_mm256_movemask_epi8(ws);
+        if (other) return At + (size_t)__builtin_ctz(other);
+        At += 32;
+    }
+    return json__skip_whitespace_scalar(data, len, At);
+}
+
+__attribute__((target("avx2")))
+size_t json__find_string_end_avx2(const char *data, size_t len, size_t At) {
+    while (At + 32 <= len) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + At));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+        if (mask) return At + (size_t)__builtin_ctz(mask);
+        At += 32;
+    }
+    return json__find_string_end_scalar(data, len, At);
+}
+
+__attribute__((target("avx2")))
+bool json__validate_utf8_avx2(const char *data, size_t len) {
+    const uint8_t *s = (const uint8_t *)data;
+    size_t i = 0;
+    while (i < len) {
+        if (i + 32 <= len) {
+            uint32_t high = (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(s + i)));
+            if (high == 0) {
+                i += 32;
+                continue;
+            }
+            i += (size_t)__builtin_ctz(high);
+        }
+        size_t n = json__utf8_sequence(s + i, len - i);
+        if (n == 0) return false;
+        i += n;
+    }
+    return true;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void json__classify_block_avx512(const uint8_t *block, Json_Block_Masks *m) {
+    __m512i v = _mm512_loadu_si512((const void *)block);
+    __m512i lower = _mm512_or_si512(v, _mm512_set1_epi8(0x20));
+    m->whitespace = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(' '))
+                  | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\t'))
+                  | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'))
+                  | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\r'));
+    m->op = _mm512_cmpeq_epi8_mask(lower, _mm512_set1_epi8('{'))
+          | _mm512_cmpeq_epi8_mask(lower, _mm512_set1_epi8('}'))
+          | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(':'))
+          | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(','));
+    m->quote = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('"'));
+    m->backslash = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\\'));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+size_t json__skip_whitespace_avx512(const char *data, size_t len, size_t At) {
+    while (At + 64 <= len) {
+        __m512i v = _mm512_loadu_si512((const void *)(data + At));
+        uint64_t ws = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(' '))
+                    | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\t'))
+                    | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'))
+                    | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\r'));
+        if (~ws) return At + (size_t)__builtin_ctzll(~ws);
+        At += 64;
+    }
+    return json__skip_whitespace_scalar(data, len, At);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+size_t json__find_string_end_avx512(const char *data, size_t len, size_t At) {
+    while (At + 64 <= len) {
+        __m512i v = _mm512_loadu_si512((const void *)(data + At));
+        uint64_t mask = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('"'))
+                      | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\\'));
+        if (mask) return At + (size_t)__builtin_ctzll(mask);
+        At += 64;
+    }
+    return json__find_string_end_scalar(data, len, At);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+bool json__validate_utf8_avx512(const char *data, size_t len) {
+    const uint8_t *s = (const uint8_t *)data;
+    size_t i = 0;
+    while (i < len) {
+        if (i + 64 <= len) {
+            uint64_t high = _mm512_movepi8_mask(_mm512_loadu_si512((const void *)(s + i)));
+            if (high == 0) {
+                i += 64;
+                continue;
+            }
+            i += (size_t)__builtin_ctzll(high);
+        }
+        size_t n = json__utf8_sequence(s + i, len - i);
+        if (n == 0) return false;
+        i += n;
+    }
+    return true;
+}
+
+#endif // JSON_SIMD_X86
+
+const Json_Kernels json__kernel_table[JSON_KERNEL_COUNT] = {
+    [JSON_KERNEL_SCALAR] = {
+        JSON_KERNEL_SCALAR,
+        json__classify_block_scalar, json__skip_whitespace_scalar,
+        json__find_string_end_scalar, json__validate_utf8_scalar,
+    },
+#ifdef JSON_SIMD_X86
+    [JSON_KERNEL_SSE] = {
+        JSON_KERNEL_SSE,
+        json__classify_block_sse, json__skip_whitespace_sse,
+        json__find_string_end_sse, json__validate_utf8_sse,
+    },
+    [JSON_KERNEL_AVX2] = {
+        JSON_KERNEL_AVX2,
+        json__classify_block_avx2, json__skip_whitespace_avx2,
+        json__find_string_end_avx2, json__validate_utf8_avx2,
+    },
+    [JSON_KERNEL_AVX512] = {
+        JSON_KERNEL_AVX512,
+        json__classify_block_avx512, json__skip_whitespace_avx512,
+        json__find_string_end_avx512, json__validate_utf8_avx512,
+    },
+#endif
+};
+
+const char *json_kernel_name(Json_Kernel kind) {
+    switch (kind) {
+        case JSON_KERNEL_SCALAR: return "scalar";
+        case JSON_KERNEL_SSE: return "sse";
+        case JSON_KERNEL_AVX2: return "avx2";
+        case JSON_KERNEL_AVX512: return "avx512";
+        default: return "unknown";
+    }
+}
+
+bool json__kernel_supported(Json_Kernel kind) {
+#ifdef JSON_SIMD_X86
+    __builtin_cpu_init();
+    switch (kind) {
+        case JSON_KERNEL_SCALAR: return true;
+        case JSON_KERNEL_SSE: return __builtin_cpu_supports("sse2");
+        case JSON_KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+        case JSON_KERNEL_AVX512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+        default: return false;
+    }
+#else
+    return kind == JSON_KERNEL_SCALAR;
+#endif
+}
+
+Json_Kernel json__select_kernel(void) {
+    const char *forced = getenv("cjson_force_kernel");
+    if (forced && *forced) {
+        for (int k = 0; k < JSON_KERNEL_COUNT; ++k) {
+            if (strcmp(forced, json_kernel_name((Json_Kernel)k)) != 0) continue;
+            if (json__kernel_supported((Json_Kernel)k)) return (Json_Kernel)k;
+            fprintf(stderr, "[WARNING] cjson_force_kernel=%s is not supported by this CPU, ignoring it\n", forced);
+            break;
+        }
+        if (strcmp(forced, "scalar") && strcmp(forced, "sse") && strcmp(forced, "avx2") && strcmp(forced, "avx512")) {
+            fprintf(stderr, "[WARNING] Unknown cjson_force_kernel=%s (expected scalar, sse, avx2 or avx512)\n", forced);
+        }
+    }
+
+    for (int k = JSON_KERNEL_COUNT - 1; k > JSON_KERNEL_SCALAR; --k) {
+        if (json__kernel_supported((Json_Kernel)k)) return (Json_Kernel)k;
+    }
+    return JSON_KERNEL_SCALAR;
+}
+
+const Json_Kernels *json_kernels(void) {
+    static const Json_Kernels *selected = NULL;
+    // selection is idempotent, so racing threads at worst both run it
+    const Json_Kernels *k = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+    if (k == NULL) {
+        k = &json__kernel_table[json__select_kernel()];
+        __atomic_store_n(&selected, k, __ATOMIC_RELEASE);
+    }
+    return k;
+}
+
+// Bit i of the result is the xor of bits 0..i of x, i.e. it is set for every
+// byte that has an odd number of quotes at or before it.
+uint64_t json__prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// Returns the mask of characters escaped by a backslash. A run of backslashes
+// escapes every other character, so the parity of where each run starts
+// decides which ones are escapes and which are escaped.
+uint64_t json__find_escaped(uint64_t backslash, uint64_t *prev_escaped) {
+    if (backslash == 0) {
+        uint64_t escaped = *prev_escaped;
+        *prev_escaped = 0;
+        return escaped;
+    }
+    // a backslash escaped by the previous block is not itself an escape
+    backslash &= ~*prev_escaped;
+    uint64_t follows_escape = (backslash << 1) | *prev_escaped;
+
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    uint64_t odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+    uint64_t sequences_starting_on_even_bits = odd_sequence_starts + backslash;
+    // the carry out of the addition means the last run reaches the next block
+    *prev_escaped = sequences_starting_on_even_bits < odd_sequence_starts ? 1 : 0;
+    uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+
+    return (even_bits ^ invert_mask) & follows_escape;
+}
+
+// Token start candidates of a block, whether in a string or not, and the
+// bytes that are string contents. Structurals are `candidates & ~*string_tail`.
+uint64_t json__block_candidates(const Json_Block_Masks *m, Json_Scanner_State *s, uint64_t *string_tail) {
+    uint64_t escaped = json__find_escaped(m->backslash, &s->prev_escaped);
+    uint64_t quote = m->quote & ~escaped;
+
+    // the opening quote is inside the string, the closing one is not
+    uint64_t in_string = json__prefix_xor(quote) ^ s->prev_in_string;
+    s->prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+    // everything inside a string except for its opening quote
+    *string_tail = in_string ^ quote;
+
+    // numbers and literals start at the first non-whitespace, non-structural
+    // byte that does not directly follow another such byte
+    uint64_t scalar = ~(m->op | m->whitespace);
+    uint64_t nonquote_scalar = scalar & ~quote;
+    uint64_t follows_nonquote_scalar = (nonquote_scalar << 1) | s->prev_scalar;
+    s->prev_scalar = nonquote_scalar >> 63;
+    uint64_t scalar_start = scalar & ~follows_nonquote_scalar;
+
+    return m->op | scalar_start;
+}
+
+uint64_t json_block_structurals(const Json_Block_Masks *m, Json_Scanner_State *s) {
+    uint64_t string_tail;
+    uint64_t candidates = json__block_candidates(m, s, &string_tail);
+    return candidates & ~string_tail;
+}
+
+bool json__structurals_reserve(Json_Structurals *s, size_t expected_capacity) {
+    if (expected_capacity <= s->capacity) return true;
+    size_t capacity = s->capacity == 0 ? 1024 : s->capacity;
+    while (capacity < expected_capacity) capacity *= 2;
+    uint32_t *items = realloc(s->items, capacity*sizeof(*s->items));
+    if (items == NULL) return false;
+    s->items = items;
+    s->capacity = capacity;
+    return true;
+}
+
+void json__flatten_bits(Json_Structurals *s, uint32_t base, uint64_t bits) {
+    uint32_t *out = s->items + s->count;
+    while (bits) {
+        *out++ = base + (uint32_t)__builtin_ctzll(bits);
+        bits &= bits - 1;
+    }
+    s->count = (size_t)(out - s->items);
+}
+
+bool json_find_structurals(const char *data, size_t len, Json_Structurals *out) {
+    out->count = 0;
+    if (len >= UINT32_MAX) return false;
+
+    void (*classify_block)(const uint8_t *, Json_Block_Masks *) = json_kernels()->classify_block;
+    Json_Scanner_State state = {0};
+    Json_Block_Masks masks;
+    size_t At = 0;
+    for (; At + JSON_BLOCK_SIZE <= len; At += JSON_BLOCK_SIZE) {
+        if (!json__structurals_reserve(out, out->count + JSON_BLOCK_SIZE)) return false;
+        classify_block((const uint8_t *)data + At, &masks);
+        json__flatten_bits(out, (uint32_t)At, json_block_structurals(&masks, &state));
+    }
+
+    if (At < len) {
+        // the last block reads into the padding, bits past the end are dropped
+        uint64_t valid = (1ULL << (len - At)) - 1;
+        if (!json__structurals_reserve(out, out->count + JSON_BLOCK_SIZE)) return false;
+        classify_block((const uint8_t *)data + At, &masks);
+        masks.quote &= valid;
+        masks.backslash &= valid;
+        json__flatten_bits(out, (uint32_t)At, json_block_structurals(&masks, &state) & valid);
+    }
+
+    return state.prev_in_string == 0;
+}
+
+bool json_find_structurals_slice(const char *data, size_t len, size_t start, size_t end, Json_Slice_Structurals *out) {
+    out->outside.count = 0;
+    out->inside.count = 0;
+    out->flips = false;
+    if (len >= UINT32_MAX) return false;
+
+    // what the blocks before `start` would have carried over: an odd run of
+    // backslashes escapes the first byte, and a scalar byte continues
+    Json_Scanner_State state = {0};
+    size_t run = 0;
+    while (run < start && data[start - run - 1] == '\\') run += 1;
+    state.prev_escaped = run % 2;
+    if (start > 0) {
+        switch (data[start - 1]) {
+            case ' ': case '\t': case '\n': case '\r':
+            case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+                break;
+            default:
+                state.prev_scalar = 1;
+        }
+    }
+
+    void (*classify_block)(const uint8_t *, Json_Block_Masks *) = json_kernels()->classify_block;
+    Json_Block_Masks masks;
+    for (size_t At = start; At < end; At += JSON_BLOCK_SIZE) {
+        if (!json__structurals_reserve(&out->outside, out->outside.count + JSON_BLOCK_SIZE)) return false;
+        if (!json__structurals_reserve(&out->inside, out->inside.count + JSON_BLOCK_SIZE)) return false;
+        classify_block((const uint8_t *)data + At, &masks);
+        // the last block of the slice may be the end of the input and read
+        // into the padding, or stop short of JSON_BLOCK_SIZE
+        uint64_t valid = end - At < JSON_BLOCK_SIZE ? (1ULL << (end - At)) - 1 : ~0ULL;
+        masks.quote &= valid;
+        masks.backslash &= valid;
+        uint64_t string_tail;
+        uint64_t candidates = json__block_candidates(&masks, &state, &string_tail) & valid;
+        json__flatten_bits(&out->outside, (uint32_t)At, candidates & ~string_tail);
+        json__flatten_bits(&out->inside, (uint32_t)At, candidates & string_tail);
+    }
+
+    out->flips = state.prev_in_string != 0;
+    return true;
+}
+
+void json_structurals_free(Json_Structurals *s) {
+    free(s->items);
+    s->items = NULL;
+    s->count = 0;
+    s->capacity = 0;
+}
+
+#endif // JSON_SIMD_IMPLEMENTATION
@@ -0,0 +1,895 @@
+// Checks for the parser. Pulls in json.c whole, so everything in there is
+// reachable from here; its main is renamed out of the way.
+#define main json_parser_main
+#include "json.c"
+#undef main
+
+size_t failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            nob_log(NOB_ERROR, "%s:%d: %s", __FILE__, __LINE__, #cond); \
+            failures += 1; \
+        } \
+    } while (0)
+
+// json_parse_number has to take all of `text`, and come out as `kind`
+bool ParsesNumber(const char *text, Json_Number_Kind kind) {
+    Json_Number number;
+    size_t len = json_parse_number(text, strlen(text), &number);
+    return len == strlen(text) && number.kind == kind;
+}
+
+void TestNumbers(void) {
+    CHECK(ParsesNumber("0", JSON_NUMBER_INT));
+    CHECK(ParsesNumber("-0", JSON_NUMBER_INT));
+    CHECK(ParsesNumber("10", JSON_NUMBER_INT));
+    CHECK(ParsesNumber("-9223372036854775808", JSON_NUMBER_INT));
+    CHECK(ParsesNumber("18446744073709551615", JSON_NUMBER_UINT));
+    CHECK(ParsesNumber("0.5", JSON_NUMBER_DOUBLE));
+    CHECK(ParsesNumber("-0.5e10", JSON_NUMBER_DOUBLE));
+    CHECK(ParsesNumber("1E-2", JSON_NUMBER_DOUBLE));
+
+    Json_Number number;
+    CHECK(json_parse_number("01", 2, &number) == 0);
+    CHECK(json_parse_number("-01", 3, &number) == 0);
+    CHECK(json_parse_number("00.5", 4, &number) == 0);
+    CHECK(json_parse_number("-", 1, &number) == 0);
+}
+
+// Copies `text` into an input with the padding the tokenizers expect.
+Json_Input InputFrom(const char *text) {
+    Nob_String_Builder sb = {0};
+    nob_sb_append_cstr(&sb, text);
+    return json_input_from_sb(&sb);
+}
+
+// Parses `text` into a tree and writes it back minified into `out`.
+bool TreeParses(const char *text, Json_Parse_Options opts, Nob_String_Builder *out) {
+    Json_Input in = InputFrom(text);
+    Tokens tokens = {0};
+    Json_Arena arena = arena_for_input(in.count);
+    Json_Element *root = Tokenize(in, &tokens) ? ParseTokensEx(&arena, tokens, opts) : NULL;
+    if (root) *out = Element2Json(root, JSON_WRITE_MINIFIED);
+    arena_free(&arena);
+    nob_da_free(tokens);
+    json_input_release(&in);
+    return root != NULL;
+}
+
+bool TreeRoundTrips(const char *text, const char *expected) {
+    Nob_String_Builder out = {0};
+    bool ok = TreeParses(text, (Json_Parse_Options){0}, &out)
+        && out.count == strlen(expected)
+        && memcmp(out.items, expected, out.count) == 0;
+    nob_sb_free(out);
+    return ok;
+}
+
+bool TreeFails(const char *text) {
+    Nob_String_Builder out = {0};
+    bool ok = TreeParses(text, (Json_Parse_Options){0}, &out);
+    nob_sb_free(out);
+    return !ok;
+}
+
+void TestTree(void) {
+    CHECK(TreeRoundTrips("[1, \"a\", {\"k\": null}]", "[1,\"a\",{\"k\":null}]"));
+    CHECK(TreeRoundTrips("{\"a\": [], \"b\": {}, \"c\": [[1], {\"d\": true}]}", "{\"a\":[],\"b\":{},\"c\":[[1],{\"d\":true}]}"));
+    // strings keep their length, embedded NULs included
+    CHECK(TreeRoundTrips("[\"a\\u0000b\"]", "[\"a\\u0000b\"]"));
+    CHECK(TreeRoundTrips("{\"k\": \"\\u0000\"}", "{\"k\":\"\\u0000\"}"));
+    CHECK(TreeRoundTrips("{\"a\\u0000b\": 1}", "{\"a\\u0000b\":1}"));
+
+    // the same grammar SaxParse checks
+    CHECK(TreeFails("[1 2]"));
+    CHECK(TreeFails("{\"a\" 1}"));
+    CHECK(TreeFails("{\"a\":"));
+    CHECK(TreeFails("{\"a\"}"));
+    CHECK(TreeFails("{1: 2}"));
+    CHECK(TreeFails("[1,]"));
+    CHECK(TreeFails("[,1]"));
+    CHECK(TreeFails("{,}"));
+    CHECK(TreeFails("[1:2]"));
+    CHECK(TreeFails("[}"));
+    CHECK(TreeFails("}"));
+    CHECK(TreeFails("[[1]"));
+    CHECK(TreeFails("1 2"));
+}
+
+// Parses `text` into a tree owned by `arena`; NULL when it is malformed.
+Json_Element *ParseTree(Json_Arena *arena, const char *text, Json_Parse_Options opts) {
+    Json_Input in = InputFrom(text);
+    Tokens tokens = {0};
+    *arena = arena_for_input(in.count);
+    Json_Element *root = Tokenize(in, &tokens) ? ParseTokensEx(arena, tokens, opts) : NULL;
+    nob_da_free(tokens);
+    json_input_release(&in);
+    return root;
+}
+
+// An object of `n` members "k0": 0, "k1": 1, ... finds every one of them.
+bool ObjectGetsMembers(size_t n) {
+    Nob_String_Builder text = {0};
+    nob_sb_append_cstr(&text, "{");
+    for (size_t i = 0; i < n; ++i) {
+        if (i > 0) nob_sb_append_cstr(&text, ",");
+        nob_sb_appendf(&text, "\"k%zu\":%zu", i, i);
+    }
+    nob_sb_append_cstr(&text, "}");
+    nob_sb_append_null(&text);
+
+    Json_Arena arena;
+    Json_Element *root = ParseTree(&arena, text.items, (Json_Parse_Options){0});
+    bool ok = root != NULL && root->count == n;
+    char key[32];
+    for (size_t i = 0; ok && i < n; ++i) {
+        int len = snprintf(key, sizeof(key), "k%zu", i);
+        Json_Element *m = json_object_get(root, key, len);
+        ok = m != NULL && m->kind == JK_INT && m->value.integer == (int64_t)i;
+    }
+    // a prefix of a key, or a key with more after it, is not the key
+    ok = ok && json_object_get(root, "k", 1) == NULL;
+    ok = ok && json_object_get(root, "k0x", 3) == NULL;
+    ok = ok && json_object_get(root, "missing", 7) == NULL;
+    arena_free(&arena);
+    nob_sb_free(text);
+    return ok;
+}
+
+// Keys holding \u0000 are matched on their full length.
+bool ObjectGetsNulKeys(size_t padding) {
+    Nob_String_Builder text = {0};
+    nob_sb_append_cstr(&text, "{\"a\\u0000b\": 1, \"a\": 2");
+    for (size_t i = 0; i < padding; ++i) nob_sb_appendf(&text, ", \"p%zu\": 0", i);
+    nob_sb_append_cstr(&text, "}");
+    nob_sb_append_null(&text);
+
+    Json_Arena arena;
+    Json_Element *root = ParseTree(&arena, text.items, (Json_Parse_Options){0});
+    Json_Element *a = json_object_get(root, "a", 1);
+    Json_Element *anb = json_object_get(root, "a\0b", 3);
+    bool ok = a != NULL && a->value.integer == 2
+        && anb != NULL && anb->value.integer == 1 && anb->key_len == 3
+        && json_object_get(root, "a\0", 2) == NULL;
+    arena_free(&arena);
+    nob_sb_free(text);
+    return ok;
+}
+
+// json_object_get searches small objects, and hashes from JSON_INDEX_LAZY_MIN
+// and JSON_INDEX_EAGER_MIN members on.
+void TestObjectGet(void) {
+    CHECK(ObjectGetsMembers(0));
+    CHECK(ObjectGetsMembers(3));
+    CHECK(ObjectGetsMembers(JSON_INDEX_LAZY_MIN - 1));
+    CHECK(ObjectGetsMembers(JSON_INDEX_LAZY_MIN));
+    CHECK(ObjectGetsMembers(JSON_INDEX_EAGER_MIN + 1));
+    CHECK(ObjectGetsNulKeys(0));
+    CHECK(ObjectGetsNulKeys(JSON_INDEX_LAZY_MIN));
+    CHECK(ObjectGetsNulKeys(JSON_INDEX_EAGER_MIN));
+
+    // the first of duplicate keys wins, indexed or not
+    Json_Arena arena;
+    Json_Element *root = ParseTree(&arena, "{\"a\": 1, \"a\": 2}", (Json_Parse_Options){0});
+    Json_Element *a = json_object_get(root, "a", 1);
+    CHECK(a != NULL && a->value.integer == 1);
+    arena_free(&arena);
+}
+
+// json_array_at reaches every element by position and nothing past them.
+void TestArrayAt(void) {
+    Json_Arena arena;
+    Json_Element *root = ParseTree(&arena, "[[], [10, 11, 12], {\"a\": 1}]", (Json_Parse_Options){0});
+    CHECK(root != NULL && json_array_len(root) == 3);
+    Json_Element *empty = json_array_at(root, 0);
+    CHECK(empty != NULL && json_array_len(empty) == 0 && json_array_at(empty, 0) == NULL);
+    Json_Element *arr = json_array_at(root, 1);
+    CHECK(arr != NULL && json_array_len(arr) == 3);
+    for (size_t i = 0; i < 3; ++i) {
+        Json_Element *e = json_array_at(arr, i);
+        CHECK(e != NULL && e->value.integer == 10 + (int64_t)i);
+    }
+    CHECK(json_array_at(arr, 3) == NULL);
+    CHECK(json_array_at(arr, SIZE_MAX) == NULL);
+    CHECK(json_array_at(root, 3) == NULL);
+    // only arrays have positions
+    Json_Element *obj = json_array_at(root, 2);
+    CHECK(obj != NULL && json_array_at(obj, 0) == NULL && json_array_len(obj) == 0);
+    CHECK(json_array_at(NULL, 0) == NULL);
+    arena_free(&arena);
+}
+
+// Two documents parsed through one Json_Context share their key text, and a
+// key looked up through the context matches by pointer.
+void TestInternKeys(void) {
+    Json_Context ctx = {0};
+    Json_Parse_Options opts = { .ctx = &ctx };
+    Json_Arena a, b;
+    Json_Element *first = ParseTree(&a, "{\"name\": 1, \"id\": 2}", opts);
+    // the same keys, one of them escaped, in another order
+    Json_Element *second = ParseTree(&b, "{\"id\": 3, \"n\\u0061me\": 4}", opts);
+    CHECK(first != NULL && second != NULL);
+
+    const char *name = json_intern(&ctx, "name", 4);
+    Json_Element *m1 = json_object_get(first, name, 4);
+    Json_Element *m2 = json_object_get(second, name, 4);
+    CHECK(m1 != NULL && m2 != NULL && m1->key == name && m2->key == name && m2->key_len == 4);
+    CHECK(json_object_get(first, "id", 2)->key == json_object_get(second, "id", 2)->key);
+    CHECK(json_intern_find(&ctx, "id", 2) == json_intern_id(&ctx, "id", 2));
+    CHECK(json_intern_find(&ctx, "other", 5) == JSON_INTERN_NONE);
+
+    // without a context every document has its own copies
+    Json_Arena c;
+    Json_Element *third = ParseTree(&c, "{\"name\": 5}", (Json_Parse_Options){0});
+    Json_Element *m3 = json_object_get(third, "name", 4);
+    CHECK(m3 != NULL && m3->key != name);
+
+    arena_free(&a);
+    arena_free(&b);
+    arena_free(&c);
+    json_context_free(&ctx);
+}
+
+// Navigates a document with cursors, without building a tree.
+void TestCursor(void) {
+    Json_Input in = InputFrom("{\"skip\": {\"a\": [1, {\"b\": 2}]}, \"k\\u0065y\": [10, \"x\", [], {}, 14], \"last\": true}");
+    Json_Document doc;
+    CHECK(json_document_init(&doc, in));
+    Json_Cursor root, arr, c;
+    CHECK(json_document_root(&doc, &root) && json_cursor_kind(root) == JK_OBJECT);
+
+    // the key is matched decoded; the value before it is skipped whole
+    CHECK(json_cursor_find(root, "key", 3, &arr) && json_cursor_kind(arr) == JK_ARRAY);
+    CHECK(!json_cursor_find(root, "a", 1, &c));
+    CHECK(!json_cursor_find(arr, "key", 3, &c));
+
+    int64_t n;
+    CHECK(json_cursor_at(arr, 0, &c) && json_cursor_int64(c, &n) && n == 10);
+    CHECK(json_cursor_at(arr, 4, &c) && json_cursor_int64(c, &n) && n == 14);
+    CHECK(!json_cursor_at(arr, 5, &c));
+    CHECK(!json_cursor_at(root, 0, &c));
+
+    // next walks the elements in order, over the empty containers
+    Json_Kind kinds[] = { JK_INT, JK_STRING, JK_ARRAY, JK_OBJECT, JK_INT };
+    size_t count = 0;
+    CHECK(json_cursor_first(arr, &c));
+    do {
+        CHECK(count < NOB_ARRAY_LEN(kinds) && json_cursor_kind(c) == kinds[count]);
+        count += 1;
+    } while (json_cursor_next(&c));
+    CHECK(count == NOB_ARRAY_LEN(kinds));
+    CHECK(json_cursor_at(arr, 2, &c) && !json_cursor_first(c, &c));
+
+    // and the members of an object, with their keys
+    const char *keys[] = { "skip", "k\\u0065y", "last" };
+    count = 0;
+    CHECK(json_cursor_first(root, &c));
+    do {
+        Nob_String_View key = json_cursor_key(c, NULL);
+        CHECK(count < NOB_ARRAY_LEN(keys) && nob_sv_eq(key, nob_sv_from_cstr(keys[count])));
+        count += 1;
+    } while (json_cursor_next(&c));
+    CHECK(count == NOB_ARRAY_LEN(keys));
+    bool last;
+    CHECK(json_cursor_bool(c, &last) && last);
+
+    json_document_free(&doc);
+    json_input_release(&in);
+}
+
+bool CollectMatch(Json_Cursor match, void *user) {
+    Nob_String_Builder *out = user;
+    if (out->count > 0) nob_sb_append_cstr(out, " ");
+    Nob_String_View raw = json_cursor_raw(match);
+    nob_sb_append_buf(out, raw.data, raw.count);
+    return true;
+}
+
+// Runs `pointer` over `text` and compares the raw matches, space separated.
+bool PathMatches(const char *pointer, const char *text, const char *expected) {
+    Json_Path path;
+    if (!json_path_compile(pointer, &path)) return false;
+    Json_Input in = InputFrom(text);
+    Json_Document doc;
+    Nob_String_Builder out = {0};
+    bool ok = json_document_init(&doc, in) && json_path_run(&path, &doc, CollectMatch, &out)
+        && out.count == strlen(expected) && memcmp(out.items, expected, out.count) == 0;
+    nob_sb_free(out);
+    json_document_free(&doc);
+    json_input_release(&in);
+    json_path_free(&path);
+    return ok;
+}
+
+bool StopAtMatch(Json_Cursor match, void *user) {
+    (void)match;
+    *(size_t *)user += 1;
+    return false;
+}
+
+void TestPath(void) {
+    const char *items = "{\"items\": [{\"t\": 1}, {\"u\": 2}, {\"t\": [3]}], \"t\": 4}";
+    CHECK(PathMatches("/items/*/t", items, "1 [3]"));
+    CHECK(PathMatches("/items/2/t/0", items, "3"));
+    CHECK(PathMatches("/*/t", items, ""));
+    CHECK(PathMatches("/*", "{\"a\": 1, \"b\": {\"c\": 2}}", "1 {\"c\": 2}"));
+    CHECK(PathMatches("/*", "[true, null, \"s\"]", "true null \"s\""));
+    CHECK(PathMatches("/*/*", "[[1, 2], [], {\"x\": 3}]", "1 2 3"));
+    CHECK(PathMatches("", "[1]", "[1]"));
+    // ~1 is a slash and ~0 a tilde in a step
+    CHECK(PathMatches("/a~1b/~0", "{\"a/b\": {\"~\": 5}}", "5"));
+    // every top-level value of an NDJSON buffer is searched
+    CHECK(PathMatches("/n", "{\"n\": 1}\n{\"m\": 2}\n{\"n\": 3}\n", "1 3"));
+
+    Json_Path path;
+    CHECK(!json_path_compile("items", &path));
+    CHECK(!json_path_compile("/a~2", &path));
+
+    // a callback that returns false stops the run
+    CHECK(json_path_compile("/*", &path));
+    Json_Input in = InputFrom("[1, 2, 3]");
+    Json_Document doc;
+    size_t calls = 0;
+    CHECK(json_document_init(&doc, in) && !json_path_run(&path, &doc, StopAtMatch, &calls) && calls == 1);
+    json_document_free(&doc);
+    json_input_release(&in);
+    json_path_free(&path);
+}
+
+// Parses `text` into a tree keeping only what `pointers` (NULL terminated)
+// select, and compares the minified result.
+bool Projects(const char **pointers, const char *text, const char *expected) {
+    Json_Projection projection = {0};
+    bool ok = true;
+    for (size_t i = 0; ok && pointers[i]; ++i) ok = json_projection_add(&projection, pointers[i]);
+    Nob_String_Builder out = {0};
+    Json_Parse_Options opts = { .projection = &projection };
+    ok = ok && TreeParses(text, opts, &out)
+        && out.count == strlen(expected) && memcmp(out.items, expected, out.count) == 0;
+    nob_sb_free(out);
+    json_projection_free(&projection);
+    return ok;
+}
+
+void TestProjection(void) {
+    const char *doc = "{\"a\": 1, \"b\": {\"c\": 2, \"d\": [3, 4]}, \"e\": [{\"t\": 5, \"u\": 6}, {\"u\": 7}]}";
+    CHECK(Projects((const char *[]){ "/a", NULL }, doc, "{\"a\":1}"));
+    CHECK(Projects((const char *[]){ "/b/c", NULL }, doc, "{\"b\":{\"c\":2}}"));
+    CHECK(Projects((const char *[]){ "/b", "/a", NULL }, doc, "{\"a\":1,\"b\":{\"c\":2,\"d\":[3,4]}}"));
+    CHECK(Projects((const char *[]){ "/e/*/t", NULL }, doc, "{\"e\":[{\"t\":5},{}]}"));
+    CHECK(Projects((const char *[]){ "/b/d/1", NULL }, doc, "{\"b\":{\"d\":[4]}}"));
+    CHECK(Projects((const char *[]){ "/missing", NULL }, doc, "{}"));
+    // the whole document
+    CHECK(Projects((const char *[]){ "", NULL }, "[1, {\"a\": 2}]", "[1,{\"a\":2}]"));
+    // dropped values are not built, but they are still checked
+    CHECK(!Projects((const char *[]){ "/a", NULL }, "{\"a\": 1, \"b\": [1,]}", "{\"a\":1}"));
+    CHECK(!Projects((const char *[]){ "/a", NULL }, "{\"b\": {\"c\" 1}, \"a\": 1}", "{\"a\":1}"));
+}
+
+bool TokensCheck(const char *text) {
+    Json_Input in = InputFrom(text);
+    Tokens tokens = {0};
+    bool ok = Tokenize(in, &tokens) && CheckTokens(tokens);
+    nob_da_free(tokens);
+    json_input_release(&in);
+    return ok;
+}
+
+// The token writers check the grammar without building a tree.
+void TestCheckTokens(void) {
+    CHECK(TokensCheck("{\"a\": [1, {}], \"b\": []}"));
+    CHECK(TokensCheck("1 2"));
+    CHECK(!TokensCheck("[1,]"));
+    CHECK(!TokensCheck("{\"a\":"));
+    CHECK(!TokensCheck("[1 2]"));
+    CHECK(!TokensCheck("}"));
+    CHECK(!TokensCheck("[}"));
+}
+
+// Token callback that collects the kind and text of every token.
+bool CollectToken(Token t, void *user) {
+    Nob_String_Builder *sb = user;
+    nob_sb_appendf(sb, "%d:"SV_Fmt" ", t.kind, SV_Arg(t.text));
+    return true;
+}
+
+// Feeds `text` to a Json_Stream `chunk` bytes at a time. Returns whether the
+// stream accepted it and appends what it saw to `out`.
+bool StreamChunks(const char *text, size_t chunk, Nob_String_Builder *out) {
+    Json_Stream s = {0};
+    size_t len = strlen(text);
+    bool ok = true;
+    for (size_t i = 0; ok && i < len; i += chunk) {
+        size_t n = len - i < chunk ? len - i : chunk;
+        ok = json_stream_feed(&s, text + i, n, CollectToken, out);
+    }
+    if (ok) ok = json_stream_finish(&s, CollectToken, out);
+    json_stream_free(&s);
+    return ok;
+}
+
+// The stream has to see the same tokens as Tokenize whatever the chunk size.
+bool StreamsLikeTokenize(const char *text) {
+    Json_Input in = InputFrom(text);
+    Tokens tokens = {0};
+    bool ok = Tokenize(in, &tokens);
+    Nob_String_Builder expected = {0};
+    nob_da_foreach(Token, t, &tokens) CollectToken(*t, &expected);
+
+    for (size_t chunk = 1; ok && chunk <= strlen(text); ++chunk) {
+        Nob_String_Builder got = {0};
+        ok = StreamChunks(text, chunk, &got)
+            && got.count == expected.count
+            && memcmp(got.items, expected.items, got.count) == 0;
+        nob_sb_free(got);
+    }
+    nob_sb_free(expected);
+    nob_da_free(tokens);
+    json_input_release(&in);
+    return ok;
+}
+
+bool StreamFails(const char *text) {
+    Nob_String_Builder got = {0};
+    bool ok = StreamChunks(text, strlen(text), &got);
+    nob_sb_free(got);
+    return !ok;
+}
+
+void TestStream(void) {
+    // a document that ends in a string, with and without a newline after it
+    CHECK(StreamsLikeTokenize("\"hello\""));
+    CHECK(StreamsLikeTokenize("\"hello\"\n"));
+    CHECK(StreamsLikeTokenize("[\"a\\\"b\", \"c\\\\\"]"));
+    CHECK(StreamsLikeTokenize("{\"k\": [1, -2.5e3, true, false, null]}"));
+    CHECK(StreamsLikeTokenize("12"));
+    CHECK(StreamFails("\"hello"));
+    CHECK(StreamFails("\"hello\\\""));
+    CHECK(StreamFails("[12abc]"));
+}
+
+bool CountToken(Token t, void *user) {
+    (void)t;
+    *(size_t *)user += 1;
+    return true;
+}
+
+bool TokenizesEach(const char *text) {
+    Json_Input in = InputFrom(text);
+    size_t count = 0;
+    bool ok = TokenizeEach(in, CountToken, &count);
+    json_input_release(&in);
+    return ok;
+}
+
+bool SaxCountString(void *user, Nob_String_View text, bool escaped) {
+    (void)text;
+    (void)escaped;
+    *(size_t *)user += 1;
+    return true;
+}
+
+bool SaxParses(const char *text) {
+    Json_Sax_Handlers handlers = { .on_string = SaxCountString, .on_key = SaxCountString };
+    Json_Input in = InputFrom(text);
+    size_t strings = 0;
+    bool ok = SaxParse(in, &handlers, &strings);
+    json_input_release(&in);
+    return ok;
+}
+
+// bad tokens that the tokenizer and the SAX parser have to stop on
+const char *bad_tokens[] = {
+    "[1 x]",
+    "tru",
+    "[-]",
+    "[12abc]",
+    "[truex]",
+    "[1.]",
+    "{\"a\":nullx}",
+    "[01]",
+    "[\"a\"x]",
+    "[\"abc",
+};
+
+bool TokenizesThreaded(const char *text, size_t *count) {
+    Json_Input in = InputFrom(text);
+    *count = 0;
+    // a small ring, so the producer has to wait on the consumer
+    bool ok = TokenizeEachThreaded(in, 2, CountToken, count);
+    json_input_release(&in);
+    return ok;
+}
+
+void TestTokenizeEach(void) {
+    CHECK(TokenizesEach("[1, -2.5, \"a\\u0041\", true, false, null, {}]"));
+    CHECK(TokenizesEach("  12  "));
+    for (size_t i = 0; i < NOB_ARRAY_LEN(bad_tokens); ++i) {
+        if (TokenizesEach(bad_tokens[i])) {
+            nob_log(NOB_ERROR, "TokenizeEach accepted %s", bad_tokens[i]);
+            failures += 1;
+        }
+        Json_Input in = InputFrom(bad_tokens[i]);
+        Tokens tokens = {0};
+        if (Tokenize(in, &tokens)) {
+            nob_log(NOB_ERROR, "Tokenize accepted %s", bad_tokens[i]);
+            failures += 1;
+        }
+        nob_da_free(tokens);
+        json_input_release(&in);
+    }
+
+    size_t count;
+    CHECK(TokenizesThreaded("[1, 2, 3, [4, 5], {\"a\": null}]", &count) && count == 19);
+    for (size_t i = 0; i < NOB_ARRAY_LEN(bad_tokens); ++i) {
+        if (TokenizesThreaded(bad_tokens[i], &count)) {
+            nob_log(NOB_ERROR, "TokenizeEachThreaded accepted %s", bad_tokens[i]);
+            failures += 1;
+        }
+    }
+}
+
+void TestSax(void) {
+    CHECK(SaxParses("{\"a\": [1, \"b\\n\", true, null], \"c\\u00e9\": {}}"));
+    CHECK(SaxParses("1 2 3"));
+    for (size_t i = 0; i < NOB_ARRAY_LEN(bad_tokens); ++i) {
+        if (SaxParses(bad_tokens[i])) {
+            nob_log(NOB_ERROR, "SaxParse accepted %s", bad_tokens[i]);
+            failures += 1;
+        }
+    }
+    CHECK(!SaxParses("[\"a\\q\"]"));
+    CHECK(!SaxParses("{\"\\x\": 1}"));
+    CHECK(!SaxParses("[\"\\u12\"]"));
+    CHECK(!SaxParses("[1,]"));
+    CHECK(!SaxParses("{\"a\" 1}"));
+}
+
+// Parses `text` onto a tape and writes it back minified into `out`.
+bool TapeParses(const char *text, Nob_String_Builder *out) {
+    Json_Input in = InputFrom(text);
+    Json_Tape tape = {0};
+    bool ok = ParseTape(in, &tape);
+    if (ok) *out = Tape2Json(&tape, JSON_WRITE_MINIFIED);
+    else CHECK(tape.count == 0);
+    json_tape_free(&tape);
+    json_input_release(&in);
+    return ok;
+}
+
+bool TapeRoundTrips(const char *text, const char *expected) {
+    Nob_String_Builder out = {0};
+    bool ok = TapeParses(text, &out)
+        && out.count == strlen(expected)
+        && memcmp(out.items, expected, out.count) == 0;
+    nob_sb_free(out);
+    return ok;
+}
+
+void TestTape(void) {
+    CHECK(TapeRoundTrips("{\"a\": [1, 2.5, \"x\\ty\"], \"b\": {}, \"c\": true}",
+                         "{\"a\":[1,2.5,\"x\\ty\"],\"b\":{},\"c\":true}"));
+    CHECK(TapeRoundTrips("\"hello\"", "\"hello\""));
+    for (size_t i = 0; i < NOB_ARRAY_LEN(bad_tokens); ++i) {
+        Nob_String_Builder out = {0};
+        if (TapeParses(bad_tokens[i], &out)) {
+            nob_log(NOB_ERROR, "ParseTape accepted %s", bad_tokens[i]);
+            failures += 1;
+        }
+        nob_sb_free(out);
+    }
+    Nob_String_Builder out = {0};
+    CHECK(!TapeParses("[[1, {\"a\": ", &out));
+    CHECK(!TapeParses("[\"a\\q\"]", &out));
+    nob_sb_free(out);
+}
+
+// Writes `text` with sorted keys from its tokens, its tree and its tape. The
+// token writer keeps keys as they were escaped, so it has its own expectation.
+bool SortsKeys(const char *text, const char *from_tokens, const char *decoded) {
+    Json_Write_Options opts = JSON_WRITE_MINIFIED;
+    opts.sort_keys = true;
+    Json_Input in = InputFrom(text);
+    Tokens tokens = {0};
+    Json_Arena arena = arena_for_input(in.count);
+    Json_Tape tape = {0};
+    bool ok = Tokenize(in, &tokens);
+    Json_Element *root = ok ? ParseTokensEx(&arena, tokens, (Json_Parse_Options){0}) : NULL;
+    ok = ok && root != NULL && ParseTape(in, &tape);
+    if (ok) {
+        Nob_String_Builder a = Tokens2Json(tokens, opts);
+        Nob_String_Builder b = Element2Json(root, opts);
+        Nob_String_Builder c = Tape2Json(&tape, opts);
+        ok = a.count == strlen(from_tokens) && memcmp(a.items, from_tokens, a.count) == 0
+            && b.count == strlen(decoded) && memcmp(b.items, decoded, b.count) == 0
+            && c.count == strlen(decoded) && memcmp(c.items, decoded, c.count) == 0;
+        nob_sb_free(a);
+        nob_sb_free(b);
+        nob_sb_free(c);
+    }
+    json_tape_free(&tape);
+    arena_free(&arena);
+    nob_da_free(tokens);
+    json_input_release(&in);
+    return ok;
+}
+
+void TestSortKeys(void) {
+    CHECK(SortsKeys("{}", "{}", "{}"));
+    CHECK(SortsKeys("{\"b\": 1, \"a\": {\"d\": [], \"c\": {}}}",
+                    "{\"a\":{\"c\":{},\"d\":[]},\"b\":1}",
+                    "{\"a\":{\"c\":{},\"d\":[]},\"b\":1}"));
+    // all three order members by the decoded key, not by its escapes
+    CHECK(SortsKeys("{\"\\u0062\": 1, \"a\": 2, \"c\": {\"\\u0041\": 1, \"B\": 2}}",
+                    "{\"a\":2,\"\\u0062\":1,\"c\":{\"\\u0041\":1,\"B\":2}}",
+                    "{\"a\":2,\"b\":1,\"c\":{\"A\":1,\"B\":2}}"));
+    // keys that only differ after a \u0000 are still ordered
+    CHECK(SortsKeys("{\"a\\u0000c\": 1, \"a\\u0000b\": 2, \"a\": 3}",
+                    "{\"a\":3,\"a\\u0000b\":2,\"a\\u0000c\":1}",
+                    "{\"a\":3,\"a\\u0000b\":2,\"a\\u0000c\":1}"));
+}
+
+typedef struct {
+    size_t offset;
+    bool ok;
+    size_t error;
+    int64_t n;
+} Seen_Record;
+
+typedef struct {
+    Seen_Record *items;
+    size_t capacity;
+    size_t count;
+} Seen_Records;
+
+bool CollectRecord(const Json_Record *record, void *user) {
+    Seen_Record seen = { .offset = record->offset, .ok = record->ok, .error = record->error, .n = -1 };
+    Json_Element *n = json_object_get(record->root, "n", 1);
+    if (n) seen.n = n->value.integer;
+    nob_da_append((Seen_Records *)user, seen);
+    return true;
+}
+
+int CompareSeenRecords(const void *a, const void *b) {
+    size_t oa = ((const Seen_Record *)a)->offset;
+    size_t ob = ((const Seen_Record *)b)->offset;
+    return (oa > ob) - (oa < ob);
+}
+
+// Parses `lines` records {"n": i} in small chunks, with line `bad` broken
+// (none when it is out of range), and checks that every record comes back
+// once and, when ordered, in input order.
+bool NdjsonParses(size_t lines, size_t bad, bool ordered) {
+    Nob_String_Builder text = {0};
+    size_t bad_offset = 0;
+    for (size_t i = 0; i < lines; ++i) {
+        if (i == bad) {
+            bad_offset = text.count;
+            nob_sb_appendf(&text, "{\"n\" %zu}\n", i);
+        } else {
+            nob_sb_appendf(&text, "{\"n\": %zu}\n", i);
+        }
+    }
+    nob_sb_append_null(&text);
+    Json_Input in = InputFrom(text.items);
+    Seen_Records seen = {0};
+    Json_Ndjson_Options opts = { .threads = 4, .chunk_size = 64, .ordered = ordered };
+    bool ok = ParseNdjson(NULL, in, opts, CollectRecord, &seen) == (bad >= lines);
+
+    ok = ok && seen.count == lines;
+    if (ok && ordered) {
+        for (size_t i = 1; i < seen.count; ++i) ok = ok && seen.items[i - 1].offset < seen.items[i].offset;
+    }
+    if (seen.count > 1) qsort(seen.items, seen.count, sizeof(*seen.items), CompareSeenRecords);
+    for (size_t i = 0; ok && i < seen.count; ++i) {
+        Seen_Record r = seen.items[i];
+        if (i == bad) {
+            // the error points at the value that should have been a colon
+            ok = !r.ok && r.offset == bad_offset && r.error == bad_offset + 5 && r.n == -1;
+        } else {
+            ok = r.ok && r.n == (int64_t)i;
+        }
+    }
+    nob_da_free(seen);
+    json_input_release(&in);
+    nob_sb_free(text);
+    return ok;
+}
+
+void TestNdjson(void) {
+    CHECK(NdjsonParses(200, SIZE_MAX, true));
+    CHECK(NdjsonParses(200, SIZE_MAX, false));
+    CHECK(NdjsonParses(200, 57, true));
+    CHECK(NdjsonParses(200, 57, false));
+    CHECK(NdjsonParses(1, 0, true));
+}
+
+typedef struct {
+    Json_Pool *pool;
+    atomic_size_t *done;
+} Pool_Work;
+
+void CountTask(void *arg) {
+    atomic_fetch_add(((Pool_Work *)arg)->done, 1);
+}
+
+// Submits subtasks and waits for them from inside the pool.
+void SpawnTask(void *arg) {
+    Pool_Work *work = arg;
+    Json_Wait_Group group;
+    json_wait_group_init(&group);
+    for (size_t i = 0; i < 8; ++i) json_pool_submit(work->pool, &group, CountTask, work);
+    json_wait_group_wait(work->pool, &group);
+    json_wait_group_destroy(&group);
+    CountTask(arg);
+}
+
+// After a run every task is accounted for: the submitting thread only waits,
+// so the workers executed all of them, and nothing is left queued.
+void TestPoolStats(void) {
+    Json_Context ctx = {0};
+    Json_Pool *pool = json_context_pool(&ctx, 4);
+    atomic_size_t done;
+    atomic_init(&done, 0);
+    Pool_Work work = { pool, &done };
+
+    Json_Wait_Group group;
+    json_wait_group_init(&group);
+    for (size_t i = 0; i < 100; ++i) json_pool_submit(pool, &group, CountTask, &work);
+    for (size_t i = 0; i < 8; ++i) json_pool_submit(pool, &group, SpawnTask, &work);
+    json_wait_group_wait(pool, &group);
+    json_wait_group_destroy(&group);
+
+    Json_Pool_Stats stats = json_pool_stats(pool);
+    CHECK(atomic_load(&done) == 100 + 8*9);
+    CHECK(stats.threads == pool->count && stats.threads > 0);
+    CHECK(stats.submitted == 100 + 8*9);
+    CHECK(stats.executed == stats.submitted);
+    CHECK(stats.queued == 0);
+    CHECK(stats.stolen <= stats.executed);
+
+    // a parse on the context's pool adds its tasks to the same counts
+    Json_Input in = InputFrom("{\"n\": 0}\n{\"n\": 1}\n");
+    Seen_Records seen = {0};
+    CHECK(ParseNdjson(&ctx, in, (Json_Ndjson_Options){ .chunk_size = 1 }, CollectRecord, &seen));
+    Json_Pool_Stats after = json_pool_stats(pool);
+    CHECK(after.submitted > stats.submitted && after.executed == after.submitted && after.queued == 0);
+    nob_da_free(seen);
+    json_input_release(&in);
+    json_context_free(&ctx);
+}
+
+bool SameTokens(Tokens a, Tokens b) {
+    if (a.count != b.count) return false;
+    for (size_t i = 0; i < a.count; ++i) {
+        Token x = a.items[i], y = b.items[i];
+        if (x.kind != y.kind || x.text.data != y.text.data || x.text.count != y.text.count || x.escaped != y.escaped) return false;
+        // every number kind is 8 bytes of the same union
+        if ((x.kind == TK_INT || x.kind == TK_UINT || x.kind == TK_FLOAT) && x.uinteger != y.uinteger) return false;
+    }
+    return true;
+}
+
+// TokenizeParallel on a pool of 4 has to come out exactly like Tokenize,
+// result and tokens, for `text`.
+bool TokenizesInParallel(Json_Pool *pool, const Nob_String_Builder *text) {
+    Nob_String_Builder copy = {0};
+    nob_sb_append_buf(&copy, text->items, text->count);
+    Json_Input in = json_input_from_sb(&copy);
+    Tokens serial = {0}, parallel = {0};
+    bool serial_ok = Tokenize(in, &serial);
+    bool parallel_ok = TokenizeParallel(pool, in, &parallel);
+    bool ok = serial_ok == parallel_ok && SameTokens(serial, parallel);
+    nob_da_free(serial);
+    nob_da_free(parallel);
+    json_input_release(&in);
+    return ok;
+}
+
+// The documents are a few times JSON_PARALLEL_MIN_SLICE, so they are cut into
+// several slices, and are full of strings holding quotes, escapes, brackets
+// and multi-byte characters for the cuts to land in.
+void TestTokenizeParallel(void) {
+    Json_Context ctx = {0};
+    Json_Pool *pool = json_context_pool(&ctx, 4);
+    Nob_String_Builder text = {0};
+    nob_sb_append_cstr(&text, "[");
+    for (size_t i = 0; text.count < 4*JSON_PARALLEL_MIN_SLICE; ++i) {
+        if (i > 0) nob_sb_append_cstr(&text, ",\n");
+        nob_sb_appendf(&text, "{\"id\": %zu, \"s\": \"x\\\"{[\u00e9\\\\\", \"v\": -1.5e3, \"u\": 18446744073709551615, "
+                              "\"b\": [true, false, null], \"a\": [\"]\", {\"}\": %zu}]}", i, i);
+    }
+    size_t end = text.count;
+    nob_sb_append_cstr(&text, "]");
+    CHECK(TokenizesInParallel(pool, &text));
+
+    // a bad byte far into the document stops both at the same token
+    text.items[end - 20] = '#';
+    CHECK(TokenizesInParallel(pool, &text));
+    text.items[end - 20] = ' ';
+    // so does invalid UTF-8 in a later slice
+    char saved = text.items[3*JSON_PARALLEL_MIN_SLICE];
+    text.items[3*JSON_PARALLEL_MIN_SLICE] = (char)0xff;
+    CHECK(TokenizesInParallel(pool, &text));
+    text.items[3*JSON_PARALLEL_MIN_SLICE] = saved;
+    // and a string that never ends
+    text.count = end;
+    nob_sb_append_cstr(&text, ", \"open");
+    CHECK(TokenizesInParallel(pool, &text));
+
+    nob_sb_free(text);
+    json_context_free(&ctx);
+}
+
+// Runs `text` through ReformatPipelined from a temporary file and compares
+// the minified output.
+bool PipelineReformats(const char *text, const char *expected) {
+    const char *dir = getenv("TMPDIR");
+    if (dir == NULL || *dir == '\0') dir = "/tmp";
+    char *path = nob_temp_sprintf("%s/json_test_pipeline_XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "Could not create %s: %s", path, strerror(errno));
+        return false;
+    }
+    size_t len = strlen(text);
+    bool written = write(fd, text, len) == (ssize_t)len;
+    close(fd);
+    FILE *out = written ? tmpfile() : NULL;
+    if (out == NULL) {
+        remove(path);
+        return false;
+    }
+    bool ok = ReformatPipelined(path, out, JSON_WRITE_MINIFIED);
+
+    Nob_String_Builder got = {0};
+    char buffer[256];
+    size_t n;
+    rewind(out);
+    while ((n = fread(buffer, 1, sizeof(buffer), out)) > 0) nob_sb_append_buf(&got, buffer, n);
+    fclose(out);
+    remove(path);
+
+    ok = ok && got.count == strlen(expected) && memcmp(got.items, expected, got.count) == 0;
+    nob_sb_free(got);
+    return ok;
+}
+
+void TestPipeline(void) {
+    // a document that ends in a string, with and without a newline after it
+    CHECK(PipelineReformats("\"hello\"", "\"hello\""));
+    CHECK(PipelineReformats("\"hello\"\n", "\"hello\""));
+    CHECK(PipelineReformats("{\"a\": [1, true, \"b\"]}\n", "{\"a\":[1,true,\"b\"]}"));
+    CHECK(!PipelineReformats("\"hello", ""));
+    CHECK(!PipelineReformats("[12abc]", "["));
+}
+
+int main(void) {
+    TestNumbers();
+    TestTree();
+    TestObjectGet();
+    TestArrayAt();
+    TestInternKeys();
+    TestCursor();
+    TestPath();
+    TestProjection();
+    TestCheckTokens();
+    TestStream();
+    TestTokenizeEach();
+    TestSax();
+    TestTape();
+    TestSortKeys();
+    TestNdjson();
+    TestPoolStats();
+    TestTokenizeParallel();
+    TestPipeline();
+
+    if (failures > 0) {
+        nob_log(NOB_ERROR, "%zu checks failed", failures);
+        return 1;
+    }
+    nob_log(NOB_INFO, "All checks passed");
+    return 0;
+}
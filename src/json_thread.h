@@ -0,0 +1,462 @@
+// Threading for the parser: a small work-stealing task pool.
+//
+// Every worker thread owns a deque of tasks. A worker pushes and pops tasks
+// at the bottom of its own deque (last in, first out, so nested work stays
+// hot in cache) and, when that runs dry, steals from the top of the others'
+// (the oldest tasks, usually the biggest). Tasks submitted from outside the
+// pool are dealt out to the workers round robin. Deques are guarded by one
+// mutex per worker, so a steal only contends with that one owner.
+//
+// The pool is meant to be started once, e.g. through Json_Context, and reused
+// for every call, so creating threads is not part of any parse.
+//
+// Long-running stages that block on IO get their own threads instead and talk
+// through Json_Ring, a bounded lock-free single-producer/single-consumer queue
+// of pointers.
+//
+// Usage is the same as nob.h: include it anywhere for the declarations and
+// define JSON_THREAD_IMPLEMENTATION in exactly one translation unit. Without
+// pthreads (_WIN32) the pool has no workers and runs every task inline.
+#ifndef JSON_THREAD_H_
+#define JSON_THREAD_H_
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+typedef void (*Json_Task_Fn)(void *arg);
+
+// Counts tasks that have been submitted but not finished yet, so a caller can
+// wait for a batch of them.
+typedef struct {
+    atomic_size_t pending;
+#ifndef _WIN32
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+#endif
+} Json_Wait_Group;
+
+typedef struct {
+    Json_Task_Fn fn;
+    void *arg;
+    Json_Wait_Group *group;
+} Json_Task;
+
+struct Json_Pool;
+
+typedef struct {
+    struct Json_Pool *pool;
+    size_t index;
+#ifndef _WIN32
+    pthread_t thread;
+    // guards the deque
+    pthread_mutex_t lock;
+#endif
+    // ring buffer, the top is items[head], the bottom items[head + count - 1]
+    Json_Task *items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+
+    atomic_size_t executed;
+    // tasks this worker took from another worker's deque
+    atomic_size_t stolen;
+} Json_Pool_Worker;
+
+typedef struct Json_Pool {
+    Json_Pool_Worker *workers;
+    size_t count;
+    // tasks sitting in deques, workers sleep while it is 0
+    atomic_size_t queued;
+    atomic_size_t submitted;
+    // where the next task from outside the pool goes
+    atomic_size_t next_worker;
+#ifndef _WIN32
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t wake;
+#endif
+    bool stopping;
+} Json_Pool;
+
+typedef struct {
+    size_t threads;
+    // tasks waiting in deques right now
+    size_t queued;
+    size_t submitted;
+    size_t executed;
+    size_t stolen;
+} Json_Pool_Stats;
+
+// Starts `threads` workers, one per CPU for 0. Returns false when no thread
+// could be started; the pool then runs tasks inline and is still usable.
+bool json_pool_start(Json_Pool *pool, size_t threads);
+// Runs the tasks that are still queued, then joins the workers.
+void json_pool_stop(Json_Pool *pool);
+void json_pool_submit(Json_Pool *pool, Json_Wait_Group *group, Json_Task_Fn fn, void *arg);
+// Index of the worker running the calling thread, or `pool->count` when the
+// caller is not one of the pool's threads. Tasks use it to pick per-worker
+// state.
+size_t json_pool_worker_index(const Json_Pool *pool);
+Json_Pool_Stats json_pool_stats(Json_Pool *pool);
+
+void json_wait_group_init(Json_Wait_Group *group);
+void json_wait_group_destroy(Json_Wait_Group *group);
+// Blocks until every task of the group has finished. Called from a task, the
+// worker keeps running other tasks meanwhile instead of blocking, so nested
+// waits do not starve the pool.
+void json_wait_group_wait(Json_Pool *pool, Json_Wait_Group *group);
+
+#define JSON_CACHE_LINE 64
+
+// Bounded queue between exactly one producer and one consumer thread. Each
+// index is written by one side only and sits on its own cache line, so the
+// two sides never write to the same line. Either side can close the ring: the
+// consumer still drains what is left, the producer stops being able to push.
+typedef struct {
+    void **slots;
+    // a power of two
+    size_t capacity;
+    // next slot to push, written by the producer
+    _Alignas(JSON_CACHE_LINE) atomic_size_t tail;
+    // next slot to pop, written by the consumer
+    _Alignas(JSON_CACHE_LINE) atomic_size_t head;
+    _Alignas(JSON_CACHE_LINE) atomic_bool closed;
+} Json_Ring;
+
+// `capacity` is rounded up to a power of two.
+void json_ring_init(Json_Ring *ring, size_t capacity);
+void json_ring_free(Json_Ring *ring);
+bool json_ring_try_push(Json_Ring *ring, void *item);
+bool json_ring_try_pop(Json_Ring *ring, void **item);
+// Waits while the ring is full. False once it is closed.
+bool json_ring_push(Json_Ring *ring, void *item);
+// Waits while the ring is empty. False once it is closed and drained.
+bool json_ring_pop(Json_Ring *ring, void **item);
+void json_ring_close(Json_Ring *ring);
+// One step of waiting for the other side of a lock-free queue: spins for a
+// short while and then gives the CPU away, since that side may be stuck on
+// IO. `spins` starts at 0 for every wait.
+void json_backoff(unsigned *spins);
+
+#endif // JSON_THREAD_H_
+
+#ifdef JSON_THREAD_IMPLEMENTATION
+
+// The worker the current thread runs, NULL outside of any pool.
+_Thread_local Json_Pool_Worker *json__current_worker = NULL;
+
+void json__wait_group_finish(Json_Wait_Group *group) {
+    if (group == NULL) return;
+#ifndef _WIN32
+    pthread_mutex_lock(&group->lock);
+    if (atomic_fetch_sub(&group->pending, 1) == 1) pthread_cond_broadcast(&group->done);
+    pthread_mutex_unlock(&group->lock);
+#else
+    atomic_fetch_sub(&group->pending, 1);
+#endif
+}
+
+// `w` is the worker running the task, NULL when it runs inline.
+void json__run_task(Json_Pool_Worker *w, Json_Task task) {
+    task.fn(task.arg);
+    // counted before the group learns about it, so stats read after a wait
+    // include the task
+    if (w) atomic_fetch_add(&w->executed, 1);
+    json__wait_group_finish(task.group);
+}
+
+#ifndef _WIN32
+
+void json__deque_push(Json_Pool_Worker *w, Json_Task task) {
+    pthread_mutex_lock(&w->lock);
+    if (w->count == w->capacity) {
+        size_t capacity = w->capacity ? w->capacity*2 : 64;
+        Json_Task *items = malloc(capacity*sizeof(*items));
+        assert(items != NULL && "Buy more RAM lol");
+        for (size_t i = 0; i < w->count; ++i) items[i] = w->items[(w->head + i) % w->capacity];
+        free(w->items);
+        w->items = items;
+        w->capacity = capacity;
+        w->head = 0;
+    }
+    w->items[(w->head + w->count) % w->capacity] = task;
+    w->count += 1;
+    pthread_mutex_unlock(&w->lock);
+}
+
+// The owner takes from the bottom.
+bool json__deque_pop(Json_Pool_Worker *w, Json_Task *out) {
+    pthread_mutex_lock(&w->lock);
+    bool ok = w->count > 0;
+    if (ok) {
+        w->count -= 1;
+        *out = w->items[(w->head + w->count) % w->capacity];
+    }
+    pthread_mutex_unlock(&w->lock);
+    return ok;
+}
+
+// Thieves take from the top.
+bool json__deque_steal(Json_Pool_Worker *w, Json_Task *out) {
+    pthread_mutex_lock(&w->lock);
+    bool ok = w->count > 0;
+    if (ok) {
+        *out = w->items[w->head];
+        w->head = (w->head + 1) % w->capacity;
+        w->count -= 1;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return ok;
+}
+
+// Own deque first, then the others starting after this worker, so thieves
+// spread out over the victims.
+bool json__find_task(Json_Pool *pool, size_t self, Json_Task *out) {
+    if (atomic_load(&pool->queued) == 0) return false;
+    if (self < pool->count && json__deque_pop(&pool->workers[self], out)) {
+        atomic_fetch_sub(&pool->queued, 1);
+        return true;
+    }
+    for (size_t i = 1; i <= pool->count; ++i) {
+        size_t victim = (self + i) % pool->count;
+        if (victim == self) continue;
+        if (json__deque_steal(&pool->workers[victim], out)) {
+            atomic_fetch_sub(&pool->queued, 1);
+            if (self < pool->count) atomic_fetch_add(&pool->workers[self].stolen, 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void *json__worker_main(void *arg) {
+    Json_Pool_Worker *w = arg;
+    Json_Pool *pool = w->pool;
+    json__current_worker = w;
+    for (;;) {
+        Json_Task task;
+        if (json__find_task(pool, w->index, &task)) {
+            json__run_task(w, task);
+            continue;
+        }
+        pthread_mutex_lock(&pool->sleep_lock);
+        while (atomic_load(&pool->queued) == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->wake, &pool->sleep_lock);
+        }
+        bool done = pool->stopping && atomic_load(&pool->queued) == 0;
+        pthread_mutex_unlock(&pool->sleep_lock);
+        if (done) break;
+    }
+    json__current_worker = NULL;
+    return NULL;
+}
+
+#endif // _WIN32
+
+bool json_pool_start(Json_Pool *pool, size_t threads) {
+    memset(pool, 0, sizeof(*pool));
+#ifndef _WIN32
+    if (threads == 0) threads = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads == 0) threads = 1;
+    pthread_mutex_init(&pool->sleep_lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pool->workers = calloc(threads, sizeof(*pool->workers));
+    assert(pool->workers != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < threads; ++i) {
+        Json_Pool_Worker *w = &pool->workers[i];
+        w->pool = pool;
+        w->index = i;
+        pthread_mutex_init(&w->lock, NULL);
+    }
+    // workers look at `count` when stealing, so it only covers started ones
+    for (size_t i = 0; i < threads; ++i) {
+        if (pthread_create(&pool->workers[i].thread, NULL, json__worker_main, &pool->workers[i]) != 0) break;
+        pool->count += 1;
+    }
+    for (size_t i = pool->count; i < threads; ++i) pthread_mutex_destroy(&pool->workers[i].lock);
+    return pool->count > 0;
+#else
+    (void)threads;
+    return false;
+#endif
+}
+
+void json_pool_stop(Json_Pool *pool) {
+#ifndef _WIN32
+    if (pool->workers == NULL) return;
+    pthread_mutex_lock(&pool->sleep_lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->sleep_lock);
+    for (size_t i = 0; i < pool->count; ++i) pthread_join(pool->workers[i].thread, NULL);
+    for (size_t i = 0; i < pool->count; ++i) {
+        pthread_mutex_destroy(&pool->workers[i].lock);
+        free(pool->workers[i].items);
+    }
+    free(pool->workers);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->sleep_lock);
+#endif
+    memset(pool, 0, sizeof(*pool));
+}
+
+size_t json_pool_worker_index(const Json_Pool *pool) {
+    Json_Pool_Worker *w = json__current_worker;
+    if (w == NULL || w->pool != pool) return pool->count;
+    return w->index;
+}
+
+void json_pool_submit(Json_Pool *pool, Json_Wait_Group *group, Json_Task_Fn fn, void *arg) {
+    Json_Task task = { fn, arg, group };
+    if (group) atomic_fetch_add(&group->pending, 1);
+    atomic_fetch_add(&pool->submitted, 1);
+    if (pool->count == 0) {
+        json__run_task(NULL, task);
+        return;
+    }
+#ifndef _WIN32
+    size_t self = json_pool_worker_index(pool);
+    size_t target = self < pool->count ? self : atomic_fetch_add(&pool->next_worker, 1) % pool->count;
+    // counted before it is visible, so a thief never takes `queued` below 0
+    atomic_fetch_add(&pool->queued, 1);
+    json__deque_push(&pool->workers[target], task);
+    pthread_mutex_lock(&pool->sleep_lock);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->sleep_lock);
+#endif
+}
+
+Json_Pool_Stats json_pool_stats(Json_Pool *pool) {
+    Json_Pool_Stats stats = {
+        .threads = pool->count,
+        .queued = atomic_load(&pool->queued),
+        .submitted = atomic_load(&pool->submitted),
+    };
+    for (size_t i = 0; i < pool->count; ++i) {
+        stats.executed += atomic_load(&pool->workers[i].executed);
+        stats.stolen += atomic_load(&pool->workers[i].stolen);
+    }
+    return stats;
+}
+
+void json_wait_group_init(Json_Wait_Group *group) {
+    atomic_init(&group->pending, 0);
+#ifndef _WIN32
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->done, NULL);
+#endif
+}
+
+void json_wait_group_destroy(Json_Wait_Group *group) {
+#ifndef _WIN32
+    pthread_cond_destroy(&group->done);
+    pthread_mutex_destroy(&group->lock);
+#else
+    (void)group;
+#endif
+}
+
+void json_wait_group_wait(Json_Pool *pool, Json_Wait_Group *group) {
+#ifndef _WIN32
+    size_t self = json_pool_worker_index(pool);
+    if (self < pool->count) {
+        // a worker waiting on its own subtasks helps with them
+        while (atomic_load(&group->pending) > 0) {
+            Json_Task task;
+            if (json__find_task(pool, self, &task)) {
+                json__run_task(&pool->workers[self], task);
+            } else {
+                sched_yield();
+            }
+        }
+        // the last task may still be inside json__wait_group_finish, let it
+        // leave before the caller gets to destroy the group
+        pthread_mutex_lock(&group->lock);
+        pthread_mutex_unlock(&group->lock);
+        return;
+    }
+    pthread_mutex_lock(&group->lock);
+    while (atomic_load(&group->pending) > 0) pthread_cond_wait(&group->done, &group->lock);
+    pthread_mutex_unlock(&group->lock);
+#else
+    (void)pool;
+    (void)group;
+#endif
+}
+
+void json_ring_init(Json_Ring *ring, size_t capacity) {
+    memset(ring, 0, sizeof(*ring));
+    ring->capacity = 1;
+    while (ring->capacity < capacity) ring->capacity *= 2;
+    ring->slots = malloc(ring->capacity*sizeof(*ring->slots));
+    assert(ring->slots != NULL && "Buy more RAM lol");
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->closed, false);
+}
+
+void json_ring_free(Json_Ring *ring) {
+    free(ring->slots);
+    memset(ring, 0, sizeof(*ring));
+}
+
+bool json_ring_try_push(Json_Ring *ring, void *item) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == ring->capacity) return false;
+    ring->slots[tail & (ring->capacity - 1)] = item;
+    // publishes the slot
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+bool json_ring_try_pop(Json_Ring *ring, void **item) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&ring->tail, memory_order_acquire)) return false;
+    *item = ring->slots[head & (ring->capacity - 1)];
+    // hands the slot back to the producer
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+void json_backoff(unsigned *spins) {
+    if (*spins < 64) {
+        *spins += 1;
+    } else {
+#ifndef _WIN32
+        sched_yield();
+#endif
+    }
+}
+
+bool json_ring_push(Json_Ring *ring, void *item) {
+    unsigned spins = 0;
+    while (!atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+        if (json_ring_try_push(ring, item)) return true;
+        json_backoff(&spins);
+    }
+    return false;
+}
+
+bool json_ring_pop(Json_Ring *ring, void **item) {
+    unsigned spins = 0;
+    for (;;) {
+        if (json_ring_try_pop(ring, item)) return true;
+        // items pushed before the close are still handed out
+        if (atomic_load_explicit(&ring->closed, memory_order_acquire)) return json_ring_try_pop(ring, item);
+        json_backoff(&spins);
+    }
+}
+
+void json_ring_close(Json_Ring *ring) {
+    atomic_store_explicit(&ring->closed, true, memory_order_release);
+}
+
+#endif // JSON_THREAD_IMPLEMENTATION